@@ -0,0 +1,161 @@
+#pragma once
+
+// Minimal self-contained microbenchmark harness.
+//
+// A case is a function that performs `iters` operations and returns the
+// nanoseconds they took, so it can exclude its own setup and time work
+// spread over several threads. The harness grows `iters` until one run
+// lasts a tenth of the target time, scales it to the target, then repeats
+// the measurement and reports the median and minimum ns per operation.
+// Inputs are deterministic; --csv output is meant to be diffed between
+// commits.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/cpu_pin.hpp"
+
+namespace bench {
+
+template <typename T> inline void do_not_optimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename F> double time_ns(F &&f) {
+  const auto t0 = std::chrono::steady_clock::now();
+  f();
+  const auto dt = std::chrono::steady_clock::now() - t0;
+  return std::chrono::duration<double, std::nano>(dt).count();
+}
+
+struct Case {
+  std::string suite;
+  std::string name;
+  // Units of work per operation (e.g. recipients per fan-out), for the
+  // items/s column.
+  double items_per_op;
+  std::function<double(std::uint64_t iters)> run;
+};
+
+inline std::vector<Case> &registry() {
+  static std::vector<Case> cases;
+  return cases;
+}
+
+inline void add(std::string suite, std::string name, double items_per_op,
+                std::function<double(std::uint64_t)> run) {
+  registry().push_back(
+      {std::move(suite), std::move(name), items_per_op, std::move(run)});
+}
+
+struct Options {
+  std::string filter;
+  double min_time_s = 0.2;
+  int reps = 5;
+  bool csv = false;
+};
+
+inline void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "usage: %s [--filter substr] [--min-time seconds] "
+               "[--reps n] [--csv] [--list]\n",
+               argv0);
+}
+
+inline int main(int argc, char **argv) {
+  Options opt;
+  bool list = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool has_val = i + 1 < argc;
+    if (arg == "--filter" && has_val) {
+      opt.filter = argv[++i];
+    } else if (arg == "--min-time" && has_val) {
+      opt.min_time_s = std::atof(argv[++i]);
+    } else if (arg == "--reps" && has_val) {
+      opt.reps = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--csv") {
+      opt.csv = true;
+    } else if (arg == "--list") {
+      list = true;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+#ifdef __linux__
+  // Keeps single-threaded cases on one core between runs.
+  pin_this_thread_to_cpu(0);
+#endif
+
+  if (opt.csv) {
+    std::printf("suite,case,ns_per_op,ns_per_op_min,items_per_op\n");
+  } else {
+    std::printf("compiler %s, %u cpus, %d reps x %.2f s%s\n", __VERSION__,
+                std::thread::hardware_concurrency(), opt.reps,
+                opt.min_time_s,
+#ifdef NDEBUG
+                ""
+#else
+                ", ASSERTIONS ON (not a release build)"
+#endif
+    );
+    std::printf("%-8s %-28s %12s %12s %14s\n", "suite", "case", "ns/op",
+                "min ns/op", "items/s");
+  }
+
+  const double target_ns = opt.min_time_s * 1e9;
+  for (auto &c : registry()) {
+    const std::string full = c.suite + "/" + c.name;
+    if (!opt.filter.empty() && full.find(opt.filter) == std::string::npos) {
+      continue;
+    }
+    if (list) {
+      std::printf("%s\n", full.c_str());
+      continue;
+    }
+
+    std::uint64_t iters = 1;
+    for (double ns = c.run(iters); ns < target_ns / 10 && iters < (1ull << 40);
+         ns = c.run(iters)) {
+      iters *= ns > 0 ? std::clamp<std::uint64_t>(
+                            static_cast<std::uint64_t>(target_ns / 10 / ns),
+                            2, 100)
+                      : 100;
+    }
+    const double per_run = c.run(iters) / double(iters);
+    iters = std::max<std::uint64_t>(
+        1, static_cast<std::uint64_t>(target_ns / std::max(per_run, 1e-3)));
+
+    std::vector<double> samples;
+    for (int r = 0; r < opt.reps; ++r) {
+      samples.push_back(c.run(iters) / double(iters));
+    }
+    std::sort(samples.begin(), samples.end());
+    const double median = samples[samples.size() / 2];
+
+    if (opt.csv) {
+      std::printf("%s,%s,%.3f,%.3f,%.0f\n", c.suite.c_str(), c.name.c_str(),
+                  median, samples.front(), c.items_per_op);
+    } else {
+      std::printf("%-8s %-28s %12.2f %12.2f %13.2fM\n", c.suite.c_str(),
+                  c.name.c_str(), median, samples.front(),
+                  c.items_per_op * 1e3 / median);
+    }
+    std::fflush(stdout);
+  }
+  return 0;
+}
+
+} // namespace bench
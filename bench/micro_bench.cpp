@@ -0,0 +1,333 @@
+// Microbenchmarks for the per-packet hot path.
+//
+//   bench [--filter substr] [--min-time seconds] [--reps n] [--csv]
+//
+// parser: Parser::parse over 256 distinct packets in each wire layout
+//   (24/21 bytes, bare or behind the 8-byte Header), little- and
+//   big-endian; batch_* runs the same packets through parse_batch 64 at a
+//   time, pinned_* likewise with each sender's format already known.
+// spsc: RxPacket-sized items through SPSC between two pinned threads, one
+//   at a time and with push_n/pop_n (skipped on a single CPU).
+// router: Router::on_packet for an op=1 update against an INetOut that
+//   only reads each destination, for 10 to 10k registered players, with
+//   full broadcast and with interest management (radius 100 over a
+//   2000 x 2000 world).
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include "bench.hpp"
+#include "core/parser.hpp"
+#include "core/router.hpp"
+#include "core/spsc.hpp"
+#include "net/net_out.hpp"
+
+namespace {
+
+// ---- parser ----------------------------------------------------------------
+
+template <std::endian E>
+void encode(const Players &p, std::size_t wire, bool header, std::byte *out) {
+  using namespace wire_schema;
+  if (header) {
+    PacketHeader::encode<E>(
+        Header{0x55, 1, static_cast<std::uint16_t>(wire), p.id}, out);
+    out += PacketHeader::size;
+  }
+  if (wire == Players24::size) {
+    Players24::encode<E>(p, out);
+  } else {
+    Players21::encode<E>(p, out);
+  }
+}
+
+// One op=1 packet in the given layout and byte order.
+std::vector<std::byte> make_packet(const Players &p, std::size_t wire,
+                                   bool header, bool big) {
+  std::vector<std::byte> out((header ? sizeof(Header) : 0) + wire);
+  if (big) {
+    encode<std::endian::big>(p, wire, header, out.data());
+  } else {
+    encode<std::endian::little>(p, wire, header, out.data());
+  }
+  return out;
+}
+
+Players random_player(std::mt19937 &rng, std::uint32_t op) {
+  std::uniform_real_distribution<float> pos(-1000.0f, 1000.0f);
+  return Players{op, static_cast<std::uint32_t>(rng() % 100000), pos(rng),
+                 pos(rng), static_cast<std::uint8_t>(rng()),
+                 static_cast<std::uint32_t>(rng() % 1000)};
+}
+
+void register_parser() {
+  struct Layout {
+    const char *name;
+    std::size_t wire;
+    bool header;
+  };
+  constexpr Layout kLayouts[] = {
+      {"w24", 24, false}, {"w21", 21, false}, {"h24", 24, true},
+      {"h21", 21, true}};
+
+  for (const auto &layout : kLayouts) {
+    for (const bool big : {false, true}) {
+      auto pkts = std::make_shared<std::vector<std::vector<std::byte>>>();
+      std::mt19937 rng(42);
+      for (int i = 0; i < 256; ++i) {
+        pkts->push_back(make_packet(random_player(rng, 1), layout.wire,
+                                    layout.header, big));
+      }
+      bench::add("parser",
+                 std::string(layout.name) + (big ? "_be" : "_le"), 1,
+                 [pkts](std::uint64_t iters) {
+                   const Parser parser;
+                   return bench::time_ns([&] {
+                     for (std::uint64_t i = 0; i < iters; ++i) {
+                       const auto &pkt = (*pkts)[i & 255];
+                       bench::do_not_optimize(parser.parse(pkt));
+                     }
+                   });
+                 });
+
+      // Same packets through parse_batch in router-sized drains; still
+      // timed per packet.
+      auto views = std::make_shared<std::vector<PacketView>>();
+      for (const auto &pkt : *pkts) {
+        views->push_back({nullptr, 0, pkt});
+      }
+      bench::add("parser",
+                 std::string("batch_") + layout.name + (big ? "_be" : "_le"),
+                 1, [views](std::uint64_t iters) {
+                   const Parser parser;
+                   std::array<Players, Parser::kMaxBatch> out{};
+                   return bench::time_ns([&] {
+                     for (std::uint64_t i = 0; i < iters;
+                          i += Parser::kMaxBatch) {
+                       const auto first = static_cast<std::size_t>(i & 255);
+                       const auto n = static_cast<std::size_t>(
+                           std::min<std::uint64_t>(Parser::kMaxBatch,
+                                                   iters - i));
+                       bench::do_not_optimize(parser.parse_batch(
+                           std::span(views->data() + first, n), out));
+                       bench::do_not_optimize(out);
+                     }
+                   });
+                 });
+
+      // As above with every sender's format already learnt, as the router
+      // sees it once its FormatCache has warmed up.
+      const WireFormat pinned{static_cast<std::uint8_t>(layout.wire),
+                              layout.header, big, big};
+      bench::add("parser",
+                 std::string("pinned_") + layout.name + (big ? "_be" : "_le"),
+                 1, [views, pinned](std::uint64_t iters) {
+                   const Parser parser;
+                   std::array<Players, Parser::kMaxBatch> out{};
+                   std::array<WireFormat, Parser::kMaxBatch> formats{};
+                   return bench::time_ns([&] {
+                     for (std::uint64_t i = 0; i < iters;
+                          i += Parser::kMaxBatch) {
+                       const auto first = static_cast<std::size_t>(i & 255);
+                       const auto n = static_cast<std::size_t>(
+                           std::min<std::uint64_t>(Parser::kMaxBatch,
+                                                   iters - i));
+                       formats.fill(pinned);
+                       bench::do_not_optimize(parser.parse_batch(
+                           std::span(views->data() + first, n), out,
+                           std::span(formats.data(), n)));
+                       bench::do_not_optimize(out);
+                     }
+                   });
+                 });
+    }
+  }
+}
+
+// ---- spsc ------------------------------------------------------------------
+
+constexpr std::size_t kSpscCapacity = 1024;
+constexpr std::size_t kSpscBatch = 64;
+
+// Times `produce` on this thread against `consume` on a second one, from
+// the moment both are ready until the consumer has seen every item.
+template <typename Produce, typename Consume>
+double cross_thread(Produce produce, Consume consume) {
+  std::atomic<bool> go{false};
+  std::thread consumer([&] {
+#ifdef __linux__
+    pin_this_thread_to_cpu(1);
+#endif
+    while (!go.load(std::memory_order_acquire)) {
+    }
+    consume();
+  });
+  return bench::time_ns([&] {
+    go.store(true, std::memory_order_release);
+    produce();
+    consumer.join();
+  });
+}
+
+void register_spsc() {
+  if (std::thread::hardware_concurrency() < 2) {
+    std::fprintf(stderr, "spsc: skipped, needs two CPUs\n");
+    return;
+  }
+
+  bench::add("spsc", "push_pop", 1, [](std::uint64_t iters) {
+    SPSC<RxPacket> q(kSpscCapacity);
+    return cross_thread(
+        [&] {
+          RxPacket pkt{};
+          for (std::uint64_t i = 0; i < iters; ++i) {
+            pkt.len = i;
+            while (!q.push(pkt)) {
+            }
+          }
+        },
+        [&] {
+          RxPacket pkt{};
+          for (std::uint64_t i = 0; i < iters; ++i) {
+            while (!q.pop(pkt)) {
+            }
+            bench::do_not_optimize(pkt.len);
+          }
+        });
+  });
+
+  bench::add("spsc", "push_n_pop_n", 1, [](std::uint64_t iters) {
+    SPSC<RxPacket> q(kSpscCapacity);
+    return cross_thread(
+        [&] {
+          std::array<RxPacket, kSpscBatch> out{};
+          for (std::uint64_t i = 0; i < iters;) {
+            const auto want =
+                static_cast<std::size_t>(std::min<std::uint64_t>(
+                    kSpscBatch, iters - i));
+            std::size_t done = 0;
+            while (done < want) {
+              done += q.push_n(out.data() + done, want - done);
+            }
+            i += want;
+          }
+        },
+        [&] {
+          std::array<RxPacket, kSpscBatch> in{};
+          for (std::uint64_t got = 0; got < iters;) {
+            got += q.pop_n(in.data(), in.size());
+            bench::do_not_optimize(in);
+          }
+        });
+  });
+}
+
+// ---- router ----------------------------------------------------------------
+
+// Transport that does no I/O but reads every destination, standing in for
+// the per-recipient work a real driver does.
+struct NullOut final : INetOut {
+  std::uint64_t sum = 0;
+
+  void send_to(const Endpoint &dst, const void *, size_t len) override {
+    sum += dst.port + len;
+  }
+  void send_to_all(std::span<const Endpoint> dsts, const void *,
+                   size_t len) override {
+    for (const auto &dst : dsts) {
+      sum += dst.port + len;
+    }
+  }
+};
+
+sockaddr_storage make_addr(std::uint32_t i) {
+  sockaddr_storage ss{};
+  auto *sin = reinterpret_cast<sockaddr_in *>(&ss);
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(static_cast<std::uint16_t>(1024 + i % 60000));
+  sin->sin_addr.s_addr = htonl(0x0a000000u | i);
+  return ss;
+}
+
+// A router with `players` registered peers scattered over the world.
+struct RouterFixture {
+  NullOut out;
+  std::vector<sockaddr_storage> addrs;
+  std::vector<std::vector<std::byte>> updates;
+  std::unique_ptr<Router> router;
+
+  RouterFixture(std::size_t players, float radius) {
+    RouterConfig cfg;
+    cfg.interest_radius = radius;
+    cfg.id_rate = 0; // one sender hammering its own id
+    router = std::make_unique<Router>(out, cfg);
+
+    std::mt19937 rng(7);
+    addrs.reserve(players);
+    for (std::uint32_t id = 0; id < players; ++id) {
+      addrs.push_back(make_addr(id));
+      Players p = random_player(rng, 0);
+      p.id = id;
+      const auto bytes = make_packet(p, 24, false, false);
+      router->on_packet({&addrs.back(), sizeof(sockaddr_in), bytes});
+    }
+    // Player 0 moving around: 256 distinct update positions.
+    for (int i = 0; i < 256; ++i) {
+      Players p = random_player(rng, 1);
+      p.id = 0;
+      updates.push_back(make_packet(p, 24, false, false));
+    }
+  }
+};
+
+void register_router() {
+  for (const std::size_t players : {10, 100, 1000, 10000}) {
+    for (const float radius : {0.0f, 100.0f}) {
+      if (radius > 0 && players < 1000) {
+        continue; // too sparse to say anything about the grid
+      }
+      // Built on first use so --filter skips the setup too.
+      auto fixture = std::make_shared<std::optional<RouterFixture>>();
+      const std::string name =
+          std::string(radius > 0 ? "interest_" : "broadcast_") +
+          std::to_string(players);
+      bench::add("router", name, 1,
+                 [fixture, players, radius](std::uint64_t iters) {
+                   if (!*fixture) {
+                     fixture->emplace(players, radius);
+                   }
+                   auto &f = **fixture;
+                   return bench::time_ns([&] {
+                     for (std::uint64_t i = 0; i < iters; ++i) {
+                       f.router->on_packet(
+                           {&f.addrs[0], sizeof(sockaddr_in),
+                            f.updates[i & 255]});
+                     }
+                     bench::do_not_optimize(f.out.sum);
+                   });
+                 });
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  register_parser();
+  register_spsc();
+  register_router();
+  return bench::main(argc, argv);
+}
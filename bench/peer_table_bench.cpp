@@ -0,0 +1,139 @@
+// Player registry: core/peer_table.hpp against the unordered_map of
+// sockaddr_storage entries it replaced.
+//
+//   bench_peer_table [rounds]
+//
+// For 1k, 10k and 100k players, measures registering every id, updating
+// every endpoint in random order, and the fan-out pattern the router runs
+// per broadcast: walking every peer and touching its address.
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "core/peer_table.hpp"
+
+namespace {
+
+// Previous Router::players_ entry.
+struct LegacyPeer {
+  sockaddr_storage addr{};
+  socklen_t len{};
+};
+
+sockaddr_storage make_addr(std::uint32_t i) {
+  sockaddr_storage ss{};
+  auto *sin = reinterpret_cast<sockaddr_in *>(&ss);
+  sin->sin_family = AF_INET;
+  sin->sin_port = htons(static_cast<std::uint16_t>(1024 + i % 60000));
+  sin->sin_addr.s_addr = htonl(0x0a000000u | i);
+  return ss;
+}
+
+template <typename F>
+double time_ns(F &&f) {
+  const auto t0 = std::chrono::steady_clock::now();
+  f();
+  const auto dt = std::chrono::steady_clock::now() - t0;
+  return std::chrono::duration<double, std::nano>(dt).count();
+}
+
+// Keeps the optimizer from dropping the iterate loops.
+volatile std::uint64_t g_sink = 0;
+
+struct Result {
+  double reg = 0, update = 0, iterate = 0;
+};
+
+Result bench_legacy(const std::vector<std::uint32_t> &ids,
+                    const std::vector<std::uint32_t> &order, int rounds) {
+  Result r;
+  std::unordered_map<std::uint32_t, LegacyPeer> players;
+  r.reg = time_ns([&] {
+    for (auto id : ids) {
+      players[id] = {make_addr(id), sizeof(sockaddr_in)};
+    }
+  });
+  r.update = time_ns([&] {
+    for (auto id : order) {
+      players[id] = {make_addr(id + 1), sizeof(sockaddr_in)};
+    }
+  });
+  std::vector<LegacyPeer> fanout;
+  fanout.reserve(players.size());
+  r.iterate = time_ns([&] {
+    for (int i = 0; i < rounds; ++i) {
+      fanout.clear();
+      for (auto const &[id, peer] : players) {
+        fanout.push_back(peer);
+      }
+      g_sink = g_sink + fanout.back().addr.ss_family;
+    }
+  });
+  r.iterate /= rounds;
+  return r;
+}
+
+Result bench_table(const std::vector<std::uint32_t> &ids,
+                   const std::vector<std::uint32_t> &order, int rounds) {
+  Result r;
+  PeerTable players;
+  r.reg = time_ns([&] {
+    for (auto id : ids) {
+      players.upsert(id, Endpoint::from_sockaddr(make_addr(id),
+                                                 sizeof(sockaddr_in)));
+    }
+  });
+  r.update = time_ns([&] {
+    for (auto id : order) {
+      players.upsert(id, Endpoint::from_sockaddr(make_addr(id + 1),
+                                                 sizeof(sockaddr_in)));
+    }
+  });
+  r.iterate = time_ns([&] {
+    for (int i = 0; i < rounds; ++i) {
+      std::uint64_t sum = 0;
+      for (const auto &ep : players.endpoints()) {
+        sum += ep.port;
+      }
+      g_sink = g_sink + sum;
+    }
+  });
+  r.iterate /= rounds;
+  return r;
+}
+
+void report(const char *name, std::size_t n, const Result &r) {
+  std::printf("%-14s %8zu %12.1f %12.1f %14.1f\n", name, n, r.reg / n,
+              r.update / n, r.iterate / n);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int rounds = argc > 1 ? std::atoi(argv[1]) : 200;
+
+  std::printf("%-14s %8s %12s %12s %14s\n", "table", "players",
+              "register ns", "update ns", "iterate ns/peer");
+  std::mt19937 rng(42);
+  for (std::size_t n : {1'000u, 10'000u, 100'000u}) {
+    // Ids as a client might assign them: unique, not dense.
+    std::vector<std::uint32_t> ids(n);
+    std::iota(ids.begin(), ids.end(), 0u);
+    for (auto &id : ids) {
+      id = id * 7919u + 13u;
+    }
+    std::vector<std::uint32_t> order = ids;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    report("unordered_map", n, bench_legacy(ids, order, rounds));
+    report("PeerTable", n, bench_table(ids, order, rounds));
+  }
+  return 0;
+}
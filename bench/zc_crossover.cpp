@@ -0,0 +1,176 @@
+// Loopback crossover benchmark: IORING_OP_SENDMSG (copy) vs
+// IORING_OP_SEND_ZC from a registered buffer, across payload sizes.
+//
+//   bench_zc_crossover [messages-per-size]
+//
+// Prints one line per payload size and the smallest size at which the
+// zero-copy path wins, which is a starting point for
+// DriverConfig::zerocopy_threshold.
+#include <liburing.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr unsigned kDepth = 256;
+constexpr unsigned kBatch = 64;
+constexpr size_t kMaxPayload = 65000;
+
+struct Ring {
+  io_uring ring{};
+  Ring() {
+    if (io_uring_queue_init(kDepth, &ring, 0) < 0)
+      throw std::runtime_error("io_uring_queue_init failed");
+  }
+  ~Ring() { io_uring_queue_exit(&ring); }
+};
+
+int udp_socket() {
+  int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    throw std::runtime_error("socket: " + std::string(std::strerror(errno)));
+  return fd;
+}
+
+sockaddr_in bind_loopback(int fd) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    throw std::runtime_error("bind: " + std::string(std::strerror(errno)));
+  socklen_t len = sizeof(addr);
+  ::getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len);
+  return addr;
+}
+
+// Sends `count` datagrams of `size` bytes and waits for every completion
+// (including zero-copy notifications). Returns nanoseconds per message, or
+// a negative value if the kernel rejected the opcode.
+double run(Ring &r, int fd, sockaddr_in &dst, std::byte *buf, size_t size,
+           unsigned count, bool zc) {
+  msghdr msg{};
+  iovec iov{buf, size};
+  msg.msg_name = &dst;
+  msg.msg_namelen = sizeof(dst);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  unsigned submitted = 0;
+  unsigned outstanding = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+
+  while (submitted < count || outstanding > 0) {
+    while (submitted < count && outstanding + 2 <= kDepth &&
+           io_uring_sq_space_left(&r.ring) > 0) {
+      io_uring_sqe *sqe = io_uring_get_sqe(&r.ring);
+      if (zc) {
+        io_uring_prep_send_zc_fixed(sqe, fd, buf, size, 0, 0, 0);
+        io_uring_prep_send_set_addr(sqe, reinterpret_cast<sockaddr *>(&dst),
+                                    sizeof(dst));
+        outstanding += 2;
+      } else {
+        io_uring_prep_sendmsg(sqe, fd, &msg, 0);
+        outstanding += 1;
+      }
+      ++submitted;
+      if (submitted % kBatch == 0)
+        break;
+    }
+
+    io_uring_submit_and_wait(&r.ring, 1);
+
+    io_uring_cqe *cqe{};
+    unsigned head = 0;
+    unsigned seen = 0;
+    io_uring_for_each_cqe(&r.ring, head, cqe) {
+      ++seen;
+      if (cqe->res == -EINVAL || cqe->res == -EOPNOTSUPP) {
+        io_uring_cq_advance(&r.ring, seen);
+        return -1.0;
+      }
+      --outstanding;
+      // A zero-copy send that fails early posts no notification.
+      if (zc && !(cqe->flags & IORING_CQE_F_NOTIF) &&
+          !(cqe->flags & IORING_CQE_F_MORE))
+        --outstanding;
+    }
+    io_uring_cq_advance(&r.ring, seen);
+  }
+
+  const auto dt = std::chrono::steady_clock::now() - t0;
+  return std::chrono::duration<double, std::nano>(dt).count() / count;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const unsigned count =
+      argc > 1 ? static_cast<unsigned>(std::strtoul(argv[1], nullptr, 10))
+               : 200000;
+
+  try {
+    Ring r;
+    int rx = udp_socket();
+    int tx = udp_socket();
+    sockaddr_in dst = bind_loopback(rx);
+
+    auto buf = std::make_unique<std::byte[]>(kMaxPayload);
+    std::memset(buf.get(), 0xab, kMaxPayload);
+    iovec reg{buf.get(), kMaxPayload};
+    if (int rc = io_uring_register_buffers(&r.ring, &reg, 1); rc < 0) {
+      std::fprintf(stderr, "io_uring_register_buffers: %s\n",
+                   std::strerror(-rc));
+      return 1;
+    }
+
+    constexpr std::array<size_t, 10> sizes{64,   256,   512,   1024,  2048,
+                                           4096, 8192, 16384, 32768, 65000};
+    size_t crossover = 0;
+
+    std::printf("%8s %14s %14s %10s\n", "bytes", "copy ns/msg", "zc ns/msg",
+                "zc/copy");
+    for (size_t size : sizes) {
+      // Warm both paths so page faults and socket setup stay out of the
+      // measured run.
+      run(r, tx, dst, buf.get(), size, kBatch, false);
+      run(r, tx, dst, buf.get(), size, kBatch, true);
+
+      const double copy = run(r, tx, dst, buf.get(), size, count, false);
+      const double zc = run(r, tx, dst, buf.get(), size, count, true);
+      if (zc < 0) {
+        std::printf("kernel does not support IORING_OP_SEND_ZC\n");
+        break;
+      }
+
+      std::printf("%8zu %14.1f %14.1f %10.2f\n", size, copy, zc, zc / copy);
+      if (crossover == 0 && zc < copy)
+        crossover = size;
+    }
+
+    if (crossover)
+      std::printf("zero-copy wins from %zu bytes\n", crossover);
+    else
+      std::printf("zero-copy never won on this host\n");
+
+    ::close(tx);
+    ::close(rx);
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "fatal: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
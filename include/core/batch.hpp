@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "core/wire_schema.hpp"
+#include "models/net.hpp"
+
+/*
+Batched player state (server -> client, tick mode)
+
+header - 8 bytes
+  magic - 1 byte  (0xB7)
+  type  - 1 byte  (1 = players)
+  count - 2 bytes (records that follow)
+  tick  - 4 bytes
+records - count x 24 bytes, same layout as the 24-byte Players packet
+          (wire_schema::Players24)
+
+All multi-byte fields are little-endian.
+*/
+
+struct BatchHeader {
+  uint8_t magic;
+  uint8_t type;
+  uint16_t count;
+  uint32_t tick;
+};
+
+static_assert(sizeof(BatchHeader) == 8, "BatchHeader must stay 8 bytes");
+
+inline constexpr std::uint8_t kBatchMagic = 0xB7;
+inline constexpr std::uint8_t kBatchTypePlayers = 1;
+
+namespace wire_schema {
+
+using Batch =
+    Layout<BatchHeader, 8, Field<&BatchHeader::magic, 0>,
+           Field<&BatchHeader::type, 1>, Field<&BatchHeader::count, 2>,
+           Field<&BatchHeader::tick, 4>>;
+
+} // namespace wire_schema
+
+inline constexpr std::size_t kBatchRecord = wire_schema::Players24::size;
+
+// Packs Players records into one MTU-sized datagram at a time.
+class BatchWriter {
+public:
+  explicit BatchWriter(std::size_t mtu)
+      : buf_(std::max(mtu, sizeof(BatchHeader) + kBatchRecord)),
+        capacity_(std::min<std::size_t>(
+            (buf_.size() - sizeof(BatchHeader)) / kBatchRecord, 0xffff)) {}
+
+  void begin(std::uint32_t tick) noexcept {
+    tick_ = tick;
+    count_ = 0;
+  }
+
+  [[nodiscard]] bool full() const noexcept { return count_ == capacity_; }
+  [[nodiscard]] bool empty() const noexcept { return count_ == 0; }
+  [[nodiscard]] std::size_t capacity() const noexcept { return capacity_; }
+
+  bool add(const Players &p) noexcept {
+    if (full()) {
+      return false;
+    }
+
+    auto *rec = buf_.data() + sizeof(BatchHeader) + count_ * kBatchRecord;
+    wire_schema::Players24::encode<std::endian::little>(p, rec);
+    ++count_;
+    return true;
+  }
+
+  // Writes the header and returns the finished datagram.
+  std::span<const std::byte> finish() noexcept {
+    wire_schema::Batch::encode<std::endian::little>(
+        {kBatchMagic, kBatchTypePlayers, static_cast<std::uint16_t>(count_),
+         tick_},
+        buf_.data());
+    return {buf_.data(), sizeof(BatchHeader) + count_ * kBatchRecord};
+  }
+
+private:
+  std::vector<std::byte> buf_;
+  std::size_t capacity_;
+  std::size_t count_ = 0;
+  std::uint32_t tick_ = 0;
+};
+
+// Client-side decoder for BatchWriter datagrams.
+class BatchReader {
+public:
+  static std::optional<BatchHeader>
+  header(std::span<const std::byte> bytes) noexcept {
+    if (bytes.size() < sizeof(BatchHeader)) {
+      return std::nullopt;
+    }
+    const auto h =
+        wire_schema::Batch::decode<std::endian::little>(bytes.data());
+    if (h.magic != kBatchMagic || h.type != kBatchTypePlayers) {
+      return std::nullopt;
+    }
+    if (bytes.size() != sizeof(BatchHeader) + h.count * kBatchRecord) {
+      return std::nullopt;
+    }
+    return h;
+  }
+
+  static Players record(std::span<const std::byte> bytes,
+                        std::size_t i) noexcept {
+    const auto *rec = bytes.data() + sizeof(BatchHeader) + i * kBatchRecord;
+    return wire_schema::Players24::decode<std::endian::little>(rec);
+  }
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "core/batch.hpp"
+#include "models/net.hpp"
+
+/*
+Delta-encoded player state (server -> client, tick mode)
+
+header  - 8-byte BatchHeader with type 2 (count = records that follow)
+records - variable length:
+  id    - varint
+  mask  - 1 byte, which fields follow
+          0x01 op, 0x02 x, 0x04 y, 0x08 color, 0x10 size, 0x80 absolute
+  op    - varint
+  x, y  - zigzag varint, quantized (value / step), delta against the last
+          state sent to this peer, or the absolute value if 0x80 is set
+  color - 1 byte
+  size  - varint
+
+A peer without a baseline for an id, or any record in a keyframe, gets the
+absolute form with every field present.
+*/
+
+inline constexpr std::uint8_t kBatchTypeDelta = 2;
+
+struct QuantState {
+  std::uint32_t op = 0;
+  std::int32_t qx = 0;
+  std::int32_t qy = 0;
+  std::uint8_t color = 0;
+  std::uint32_t size = 0;
+};
+
+// Last state sent to one peer, per player id.
+using DeltaBaseline = std::unordered_map<std::uint32_t, QuantState>;
+
+namespace delta_detail {
+
+inline constexpr std::uint8_t kOp = 0x01;
+inline constexpr std::uint8_t kX = 0x02;
+inline constexpr std::uint8_t kY = 0x04;
+inline constexpr std::uint8_t kColor = 0x08;
+inline constexpr std::uint8_t kSize = 0x10;
+inline constexpr std::uint8_t kAbsolute = 0x80;
+inline constexpr std::uint8_t kAll = kOp | kX | kY | kColor | kSize;
+
+// id + mask + op + x + y + color + size, all at their widest.
+inline constexpr std::size_t kMaxRecord = 5 + 1 + 5 + 5 + 5 + 1 + 5;
+
+inline std::uint32_t zigzag(std::int32_t v) noexcept {
+  return (static_cast<std::uint32_t>(v) << 1) ^
+         static_cast<std::uint32_t>(v >> 31);
+}
+
+inline std::int32_t unzigzag(std::uint32_t v) noexcept {
+  return static_cast<std::int32_t>((v >> 1) ^ (0u - (v & 1)));
+}
+
+// Two's-complement wrapping arithmetic; a delta between extreme quantized
+// values must round-trip rather than overflow.
+inline std::int32_t wrap_sub(std::int32_t a, std::int32_t b) noexcept {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) -
+                                   static_cast<std::uint32_t>(b));
+}
+
+inline std::int32_t wrap_add(std::int32_t a, std::int32_t b) noexcept {
+  return static_cast<std::int32_t>(static_cast<std::uint32_t>(a) +
+                                   static_cast<std::uint32_t>(b));
+}
+
+inline std::byte *put_varint(std::byte *out, std::uint32_t v) noexcept {
+  while (v >= 0x80) {
+    *out++ = static_cast<std::byte>(v | 0x80);
+    v >>= 7;
+  }
+  *out++ = static_cast<std::byte>(v);
+  return out;
+}
+
+inline bool get_varint(std::span<const std::byte> in, std::size_t &off,
+                       std::uint32_t &v) noexcept {
+  v = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (off >= in.size()) {
+      return false;
+    }
+    const auto b = static_cast<std::uint8_t>(in[off++]);
+    v |= static_cast<std::uint32_t>(b & 0x7f) << shift;
+    if (!(b & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace delta_detail
+
+class DeltaEncoder {
+public:
+  DeltaEncoder(float step, std::size_t mtu)
+      : inv_step_(1.0f / std::max(step, 1e-6f)),
+        buf_(std::max(mtu, sizeof(BatchHeader) + delta_detail::kMaxRecord)) {}
+
+  void begin(std::uint32_t tick) noexcept {
+    tick_ = tick;
+    count_ = 0;
+    len_ = sizeof(BatchHeader);
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return count_ == 0; }
+
+  QuantState quantize(const Players &p) const noexcept {
+    return QuantState{p.op, quantize(p.x), quantize(p.y), p.color, p.size};
+  }
+
+  // Appends `p` against the peer's baseline and updates the baseline.
+  // Returns false, writing nothing, when the record does not fit; the
+  // caller sends finish() and starts a new datagram. A record whose
+  // quantized state did not change is skipped and counts as written.
+  bool add(const Players &p, DeltaBaseline &base, bool absolute) noexcept {
+    using namespace delta_detail;
+    const auto q = quantize(p);
+
+    std::uint8_t mask = kAll | kAbsolute;
+    QuantState prev{};
+    if (!absolute) {
+      if (auto it = base.find(p.id); it != base.end()) {
+        prev = it->second;
+        mask = static_cast<std::uint8_t>(
+            (q.op != prev.op ? kOp : 0) | (q.qx != prev.qx ? kX : 0) |
+            (q.qy != prev.qy ? kY : 0) | (q.color != prev.color ? kColor : 0) |
+            (q.size != prev.size ? kSize : 0));
+        if (mask == 0) {
+          return true;
+        }
+      }
+    }
+
+    if (len_ + kMaxRecord > buf_.size() || count_ == 0xffff) {
+      return false;
+    }
+
+    auto *out = buf_.data() + len_;
+    out = put_varint(out, p.id);
+    *out++ = static_cast<std::byte>(mask);
+    if (mask & kOp) {
+      out = put_varint(out, q.op);
+    }
+    if (mask & kX) {
+      out = put_varint(out, zigzag(wrap_sub(q.qx, prev.qx)));
+    }
+    if (mask & kY) {
+      out = put_varint(out, zigzag(wrap_sub(q.qy, prev.qy)));
+    }
+    if (mask & kColor) {
+      *out++ = static_cast<std::byte>(q.color);
+    }
+    if (mask & kSize) {
+      out = put_varint(out, q.size);
+    }
+
+    len_ = static_cast<std::size_t>(out - buf_.data());
+    ++count_;
+    base[p.id] = q;
+    return true;
+  }
+
+  std::span<const std::byte> finish() noexcept {
+    wire_schema::Batch::encode<std::endian::little>(
+        {kBatchMagic, kBatchTypeDelta, static_cast<std::uint16_t>(count_),
+         tick_},
+        buf_.data());
+    return {buf_.data(), len_};
+  }
+
+private:
+  std::int32_t quantize(float v) const noexcept {
+    constexpr float kLimit = 2147483520.0f; // largest float below 2^31
+    const auto q = std::round(v * inv_step_);
+    if (!std::isfinite(q)) {
+      return 0;
+    }
+    return static_cast<std::int32_t>(std::clamp(q, -kLimit, kLimit));
+  }
+
+  float inv_step_;
+  std::vector<std::byte> buf_;
+  std::size_t len_ = sizeof(BatchHeader);
+  std::size_t count_ = 0;
+  std::uint32_t tick_ = 0;
+};
+
+// Client-side decoder; keeps its own baseline per id.
+class DeltaDecoder {
+public:
+  explicit DeltaDecoder(float step) : step_(step) {}
+
+  // Calls fn(const Players&) for every record. Returns false on a
+  // malformed datagram (records before the error have been applied).
+  template <typename F>
+  bool apply(std::span<const std::byte> bytes, F &&fn) {
+    using namespace delta_detail;
+    if (bytes.size() < sizeof(BatchHeader)) {
+      return false;
+    }
+    const auto h =
+        wire_schema::Batch::decode<std::endian::little>(bytes.data());
+    if (h.magic != kBatchMagic || h.type != kBatchTypeDelta) {
+      return false;
+    }
+
+    const auto count = h.count;
+    std::size_t off = sizeof(BatchHeader);
+    for (std::uint16_t i = 0; i < count; ++i) {
+      std::uint32_t id = 0;
+      std::uint32_t v = 0;
+      if (!get_varint(bytes, off, id) || off >= bytes.size()) {
+        return false;
+      }
+      const auto mask = static_cast<std::uint8_t>(bytes[off++]);
+
+      auto &q = base_[id];
+      if (mask & kAbsolute) {
+        q = QuantState{};
+      }
+      if (mask & kOp) {
+        if (!get_varint(bytes, off, v)) {
+          return false;
+        }
+        q.op = v;
+      }
+      if (mask & kX) {
+        if (!get_varint(bytes, off, v)) {
+          return false;
+        }
+        q.qx = wrap_add(q.qx, unzigzag(v));
+      }
+      if (mask & kY) {
+        if (!get_varint(bytes, off, v)) {
+          return false;
+        }
+        q.qy = wrap_add(q.qy, unzigzag(v));
+      }
+      if (mask & kColor) {
+        if (off >= bytes.size()) {
+          return false;
+        }
+        q.color = static_cast<std::uint8_t>(bytes[off++]);
+      }
+      if (mask & kSize) {
+        if (!get_varint(bytes, off, v)) {
+          return false;
+        }
+        q.size = v;
+      }
+
+      fn(Players{q.op, id, static_cast<float>(q.qx) * step_,
+                 static_cast<float>(q.qy) * step_, q.color, q.size});
+    }
+    return off == bytes.size();
+  }
+
+private:
+  float step_;
+  std::unordered_map<std::uint32_t, QuantState> base_;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "core/parser.hpp"
+#include "core/rate_limit.hpp"
+#include "models/net.hpp"
+
+// Wire format learnt per source endpoint.
+//
+// A sender's format is pinned once `learn` of its packets in a row decoded
+// unambiguously in the same layout and byte order (or straight away when
+// it declares it); Parser then decodes its packets in that order alone.
+// Ambiguous packets (e.g. all-zero coordinates) neither count nor reset
+// the streak; a packet in any other format starts it over.
+//
+// Like RateLimiter, the table never allocates after construction. A key
+// that hashes onto a slot held by another key takes it over and learns
+// from scratch, which only costs that sender a few dual decodes.
+class FormatCache {
+public:
+  // `learn` == 0 disables the cache.
+  FormatCache(std::size_t slots, std::uint32_t learn)
+      : learn_(learn),
+        mask_(std::bit_ceil(slots < 1 ? std::size_t{1} : slots) - 1),
+        slots_(learn ? mask_ + 1 : 0) {}
+
+  [[nodiscard]] bool enabled() const noexcept { return learn_ > 0; }
+
+  // The format pinned for `ep`, or an unknown one.
+  [[nodiscard]] WireFormat find(const Endpoint &ep) const noexcept {
+    if (!enabled()) {
+      return {};
+    }
+    const auto &slot = slots_[EndpointHash{}(ep) & mask_];
+    return slot.key == ep && slot.streak >= learn_ ? slot.format
+                                                   : WireFormat{};
+  }
+
+  // Records the format a packet from `ep` was decoded as; unknown means
+  // the packet could have been either and says nothing.
+  void observe(const Endpoint &ep, const WireFormat &seen) noexcept {
+    if (!enabled() || !seen.known()) {
+      return;
+    }
+    auto &slot = slots_[EndpointHash{}(ep) & mask_];
+    if (!(slot.key == ep) || !(slot.format == seen)) {
+      slot = {ep, seen, 1};
+    } else if (slot.streak < learn_) {
+      ++slot.streak;
+    }
+  }
+
+  // Pins `format` for `ep` without waiting for a streak.
+  void pin(const Endpoint &ep, const WireFormat &format) noexcept {
+    if (!enabled() || !format.known()) {
+      return;
+    }
+    slots_[EndpointHash{}(ep) & mask_] = {ep, format, learn_};
+  }
+
+  // Drops what is known about `ep`, e.g. when its peer goes away and the
+  // address may be reused by a client with another format.
+  void forget(const Endpoint &ep) noexcept {
+    if (!enabled()) {
+      return;
+    }
+    auto &slot = slots_[EndpointHash{}(ep) & mask_];
+    if (slot.key == ep) {
+      slot = {};
+    }
+  }
+
+private:
+  struct Slot {
+    Endpoint key{};
+    WireFormat format{};
+    std::uint32_t streak = 0;
+  };
+
+  std::uint32_t learn_;
+  std::size_t mask_;
+  std::vector<Slot> slots_;
+};
@@ -1,6 +1,13 @@
 #pragma once
 #include <cstdint>
-enum class Op : uint8_t { RECV = 1, SEND = 2, CLOSE = 3 };
+enum class Op : uint8_t {
+  RECV = 1,
+  SEND = 2,
+  CLOSE = 3,
+  RECV_MULTI = 4,
+  WAKE = 5,
+  TIMER = 6,
+};
 
 static inline uint64_t pack_ud_slot(Op op, uint32_t slot) {
   return (uint64_t(uint32_t(op)) << 32) | uint64_t(slot);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Uniform-grid spatial index over player positions. Cells are `cell_size`
+// wide, so a radius query of at most one cell touches a 3x3 neighbourhood
+// regardless of how many players are in the session. Updates are
+// incremental: a player only changes cell buckets when it crosses a border.
+class InterestGrid {
+public:
+  explicit InterestGrid(float cell_size)
+      : cell_(std::max(cell_size, kMinCell)), inv_cell_(1.0f / cell_) {}
+
+  void update(std::uint32_t id, float x, float y) {
+    const auto cell = key(cell_of(x), cell_of(y));
+    auto [it, inserted] = where_.try_emplace(id, Where{cell, 0});
+    if (!inserted && it->second.cell == cell) {
+      auto &m = cells_[cell][it->second.slot];
+      m.x = x;
+      m.y = y;
+      return;
+    }
+    if (!inserted) {
+      erase_from_cell(it->second);
+    }
+
+    auto &bucket = cells_[cell];
+    it->second = Where{cell, static_cast<std::uint32_t>(bucket.size())};
+    bucket.push_back(Member{id, x, y});
+  }
+
+  void remove(std::uint32_t id) {
+    auto it = where_.find(id);
+    if (it == where_.end()) {
+      return;
+    }
+    erase_from_cell(it->second);
+    where_.erase(it);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return where_.size(); }
+
+  // Calls fn(id) for every player within `radius` of (x, y).
+  template <typename F>
+  void for_each_near(float x, float y, float radius, F &&fn) const {
+    const auto r2 = radius * radius;
+    const auto cx0 = cell_of(x - radius);
+    const auto cx1 = cell_of(x + radius);
+    const auto cy0 = cell_of(y - radius);
+    const auto cy1 = cell_of(y + radius);
+
+    for (auto cx = cx0; cx <= cx1; ++cx) {
+      for (auto cy = cy0; cy <= cy1; ++cy) {
+        auto it = cells_.find(key(cx, cy));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const auto &m : it->second) {
+          const auto dx = m.x - x;
+          const auto dy = m.y - y;
+          if (dx * dx + dy * dy <= r2) {
+            fn(m.id);
+          }
+        }
+      }
+    }
+  }
+
+private:
+  static constexpr float kMinCell = 1.0f / 1024.0f;
+  static constexpr float kMaxCellIndex = 1 << 30;
+
+  struct Member {
+    std::uint32_t id;
+    float x;
+    float y;
+  };
+
+  struct Where {
+    std::uint64_t cell;
+    std::uint32_t slot;
+  };
+
+  std::int32_t cell_of(float v) const noexcept {
+    // Parser admits any finite coordinate, so clamp before the int cast.
+    if (!std::isfinite(v)) {
+      return 0;
+    }
+    const auto c = std::clamp(std::floor(v * inv_cell_), -kMaxCellIndex,
+                              kMaxCellIndex);
+    return static_cast<std::int32_t>(c);
+  }
+
+  static std::uint64_t key(std::int32_t cx, std::int32_t cy) noexcept {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(cx)) << 32) |
+           static_cast<std::uint32_t>(cy);
+  }
+
+  void erase_from_cell(const Where &w) {
+    auto cit = cells_.find(w.cell);
+    auto &bucket = cit->second;
+    if (w.slot + 1 != bucket.size()) {
+      bucket[w.slot] = bucket.back();
+      where_[bucket[w.slot].id].slot = w.slot;
+    }
+    bucket.pop_back();
+    if (bucket.empty()) {
+      cells_.erase(cit);
+    }
+  }
+
+  float cell_;
+  float inv_cell_;
+  std::unordered_map<std::uint64_t, std::vector<Member>> cells_;
+  std::unordered_map<std::uint32_t, Where> where_;
+};
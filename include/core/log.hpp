@@ -1,25 +1,530 @@
 #pragma once
-#include <iostream>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Asynchronous binary logging.
+//
+// A log statement does no formatting. It copies a pointer to its call site
+// (level, format string) plus its arguments, in binary, into a ring owned
+// by the calling thread; a background writer drains every ring, formats
+// the records and writes them to stderr. The hot path pays for a clock
+// read and a few stores instead of std::cerr's lock and number formatting.
+//
+//   UDP_INFO("listening on port {} with {} shards", port, n);
+//   UDP_WARN_EVERY(1000, "router queue full: dropping packet");
+//
+// Format strings use `{}` placeholders (`{{` and `}}` for literal braces);
+// the placeholder count is checked against the arguments at compile time.
+// Arguments may be integers, floating point, bool, char, enums, pointers
+// and strings (const char*, std::string, std::string_view; copied and cut
+// at kMaxString bytes).
+//
+// Statements below UDP_LOG_LEVEL (default: info) compile to nothing, and
+// UDP_LOG_ENABLED=0 removes logging altogether. When a thread's ring is
+// full the record is dropped and counted; the writer reports the drops.
 
 #ifndef UDP_LOG_ENABLED
-#define UDP_LOG_ENABLED 1 
+#define UDP_LOG_ENABLED 1
 #endif
 
-// clangd auto formatter breaking this?
-#if UDP_LOG_ENABLED
-#define UDP_LOG(expr)                                                          \
-  do {                                                                         \
-    std::cerr << expr;                                                         \
-  } while (0)
-#define UDP_LOGLN(expr)                                                        \
-  do {                                                                         \
-    std::cerr << expr << '\n';                                                 \
-  } while (0)
-#else
-#define UDP_LOG(expr)                                                          \
+// 0 trace, 1 debug, 2 info, 3 warn, 4 error.
+#ifndef UDP_LOG_LEVEL
+#define UDP_LOG_LEVEL 2
+#endif
+
+namespace logging {
+
+enum class Level : std::uint8_t { Trace, Debug, Info, Warn, Error };
+
+inline constexpr bool enabled(Level level) noexcept {
+  return UDP_LOG_ENABLED && static_cast<int>(level) >= UDP_LOG_LEVEL;
+}
+
+// One log statement; every record it emits points here.
+struct Site {
+  Level level;
+  std::string_view fmt;
+};
+
+inline constexpr std::size_t kMaxArgs = 16;
+inline constexpr std::size_t kMaxString = 256;
+inline constexpr std::size_t kRingBytes = std::size_t{1} << 16;
+
+// Number of `{}` in `fmt`, or SIZE_MAX if a brace is unbalanced.
+constexpr std::size_t placeholders(std::string_view fmt) noexcept {
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < fmt.size(); ++i) {
+    const bool next = i + 1 < fmt.size();
+    if (fmt[i] == '{') {
+      if (next && fmt[i + 1] == '{') {
+        ++i;
+      } else if (next && fmt[i + 1] == '}') {
+        ++n;
+        ++i;
+      } else {
+        return SIZE_MAX;
+      }
+    } else if (fmt[i] == '}') {
+      if (!next || fmt[i + 1] != '}') {
+        return SIZE_MAX;
+      }
+      ++i;
+    }
+  }
+  return n;
+}
+
+namespace detail {
+
+enum class Tag : std::uint8_t { I64, U64, F64, Bool, Char, Ptr, Str };
+
+struct Header {
+  std::uint32_t size;       // whole record, multiple of 8
+  std::uint32_t suppressed; // rate-limited records skipped before this one
+  const Site *site;         // nullptr: padding up to the end of the ring
+  std::uint64_t ts_ns;      // system_clock
+};
+
+inline std::uint64_t wall_ns() noexcept {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+}
+
+template <typename T>
+inline constexpr bool is_string_v =
+    std::is_same_v<T, const char *> || std::is_same_v<T, char *> ||
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+template <typename T> std::string_view as_string(const T &v) noexcept {
+  if constexpr (std::is_pointer_v<T>) {
+    return v ? std::string_view(v, ::strnlen(v, kMaxString)) : "(null)";
+  } else {
+    return std::string_view(v).substr(0, kMaxString);
+  }
+}
+
+template <typename T> constexpr Tag tag_of() noexcept {
+  if constexpr (is_string_v<T>) {
+    return Tag::Str;
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return Tag::Bool;
+  } else if constexpr (std::is_same_v<T, char>) {
+    return Tag::Char;
+  } else if constexpr (std::is_enum_v<T>) {
+    return tag_of<std::underlying_type_t<T>>();
+  } else if constexpr (std::is_integral_v<T>) {
+    return std::is_signed_v<T> ? Tag::I64 : Tag::U64;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return Tag::F64;
+  } else {
+    static_assert(std::is_pointer_v<T>, "unsupported log argument type");
+    return Tag::Ptr;
+  }
+}
+
+template <typename T> std::size_t encoded_size(const T &v) noexcept {
+  using D = std::decay_t<T>;
+  if constexpr (is_string_v<D>) {
+    return 1 + sizeof(std::uint16_t) + as_string<D>(v).size();
+  } else {
+    return 1 + sizeof(std::uint64_t);
+  }
+}
+
+template <typename T> std::byte *encode(std::byte *p, const T &v) noexcept {
+  using D = std::decay_t<T>;
+  constexpr Tag tag = tag_of<D>();
+  *p++ = static_cast<std::byte>(tag);
+  if constexpr (tag == Tag::Str) {
+    const auto s = as_string<D>(v);
+    const auto n = static_cast<std::uint16_t>(s.size());
+    std::memcpy(p, &n, sizeof(n));
+    std::memcpy(p + sizeof(n), s.data(), n);
+    return p + sizeof(n) + n;
+  } else {
+    std::uint64_t raw = 0;
+    if constexpr (tag == Tag::F64) {
+      const double d = static_cast<double>(v);
+      std::memcpy(&raw, &d, sizeof(d));
+    } else if constexpr (tag == Tag::Ptr) {
+      raw = reinterpret_cast<std::uintptr_t>(v);
+    } else if constexpr (tag == Tag::I64) {
+      raw = static_cast<std::uint64_t>(static_cast<std::int64_t>(v));
+    } else {
+      raw = static_cast<std::uint64_t>(v);
+    }
+    std::memcpy(p, &raw, sizeof(raw));
+    return p + sizeof(raw);
+  }
+}
+
+template <typename... Args>
+std::size_t record_size(const Args &...args) noexcept {
+  const std::size_t n =
+      sizeof(Header) + (std::size_t{0} + ... + encoded_size(args));
+  return (n + 7) & ~std::size_t{7};
+}
+
+template <typename... Args>
+void write_record(std::byte *p, const Header &h, const Args &...args) noexcept {
+  std::memcpy(p, &h, sizeof(h));
+  p += sizeof(h);
+  ((p = encode(p, args)), ...);
+}
+
+// Decodes one argument at `p` onto `out`; returns the next argument.
+inline const std::byte *append_arg(std::string &out, const std::byte *p) {
+  const auto tag = static_cast<Tag>(*p++);
+  if (tag == Tag::Str) {
+    std::uint16_t n = 0;
+    std::memcpy(&n, p, sizeof(n));
+    out.append(reinterpret_cast<const char *>(p + sizeof(n)), n);
+    return p + sizeof(n) + n;
+  }
+
+  std::uint64_t raw = 0;
+  std::memcpy(&raw, p, sizeof(raw));
+  char buf[32];
+  std::to_chars_result r{buf, {}};
+  switch (tag) {
+  case Tag::I64:
+    r = std::to_chars(buf, buf + sizeof(buf), static_cast<std::int64_t>(raw));
+    break;
+  case Tag::U64:
+    r = std::to_chars(buf, buf + sizeof(buf), raw);
+    break;
+  case Tag::F64: {
+    double d = 0;
+    std::memcpy(&d, &raw, sizeof(d));
+    r = std::to_chars(buf, buf + sizeof(buf), d, std::chars_format::general,
+                      6);
+    break;
+  }
+  case Tag::Bool:
+    out.append(raw ? "true" : "false");
+    break;
+  case Tag::Char:
+    out.push_back(static_cast<char>(raw));
+    break;
+  case Tag::Ptr:
+    out.append("0x");
+    r = std::to_chars(buf, buf + sizeof(buf), raw, 16);
+    break;
+  case Tag::Str:
+    break;
+  }
+  out.append(buf, r.ptr);
+  return p + sizeof(raw);
+}
+
+// "HH:MM:SS.uuuuuu L message\n" (UTC).
+inline void format_record(std::string &out, const Header &h,
+                          const std::byte *args) {
+  const std::uint64_t us = h.ts_ns / 1000;
+  const std::uint64_t sec = us / 1'000'000 % 86400;
+  char stamp[24];
+  std::snprintf(stamp, sizeof(stamp), "%02u:%02u:%02u.%06u ",
+                static_cast<unsigned>(sec / 3600),
+                static_cast<unsigned>(sec / 60 % 60),
+                static_cast<unsigned>(sec % 60),
+                static_cast<unsigned>(us % 1'000'000));
+  out.append(stamp);
+  out.push_back("TDIWE"[static_cast<int>(h.site->level)]);
+  out.push_back(' ');
+
+  const std::string_view fmt = h.site->fmt;
+  for (std::size_t i = 0; i < fmt.size(); ++i) {
+    if (fmt[i] == '{' && fmt[i + 1] == '}') {
+      args = append_arg(out, args);
+      ++i;
+    } else {
+      out.push_back(fmt[i]);
+      if (fmt[i] == '{' || fmt[i] == '}') {
+        ++i; // escaped brace
+      }
+    }
+  }
+  if (h.suppressed > 0) {
+    out.append(" (");
+    out.append(std::to_string(h.suppressed));
+    out.append(" similar suppressed)");
+  }
+  out.push_back('\n');
+}
+
+// Byte ring with one producer (the owning thread) and one consumer (the
+// writer). Records are contiguous; one that does not fit before the end
+// of the buffer is preceded by a padding record (or, if not even a header
+// fits, by implicit padding) and starts again at offset 0.
+class Ring {
+public:
+  template <typename... Args>
+  void write(const Site &site, std::uint32_t suppressed, std::uint64_t ts,
+             const Args &...args) noexcept {
+    const std::size_t size = record_size(args...);
+    const std::uint64_t head = head_.load(std::memory_order_relaxed);
+    const std::size_t room = kRingBytes - (head & kMask);
+    const std::size_t need = room < size ? room + size : size;
+    if (kRingBytes - (head - cached_tail_) < need) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (kRingBytes - (head - cached_tail_) < need) {
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        return;
+      }
+    }
+
+    std::uint64_t pos = head;
+    if (room < size) {
+      if (room >= sizeof(Header)) {
+        const Header pad{static_cast<std::uint32_t>(room), 0, nullptr, 0};
+        std::memcpy(buf_ + (pos & kMask), &pad, sizeof(pad));
+      }
+      pos += room;
+    }
+    write_record(buf_ + (pos & kMask),
+                 Header{static_cast<std::uint32_t>(size), suppressed, &site,
+                        ts},
+                 args...);
+    head_.store(pos + size, std::memory_order_release);
+  }
+
+  // Writer thread: calls f(header, args) for every published record.
+  template <typename F> std::size_t drain(F &&f) {
+    std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    std::size_t n = 0;
+    while (tail < head) {
+      const std::size_t off = tail & kMask;
+      if (kRingBytes - off < sizeof(Header)) {
+        tail += kRingBytes - off;
+        continue;
+      }
+      Header h;
+      std::memcpy(&h, buf_ + off, sizeof(h));
+      if (h.site) {
+        f(h, buf_ + off + sizeof(h));
+        ++n;
+      }
+      tail += h.size;
+    }
+    tail_.store(tail, std::memory_order_release);
+    return n;
+  }
+
+  [[nodiscard]] std::uint64_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  // Set when the owning thread exits; the writer frees the ring once it
+  // has drained it.
+  std::atomic<bool> closed{false};
+
+private:
+  static constexpr std::uint64_t kMask = kRingBytes - 1;
+
+  alignas(64) std::atomic<std::uint64_t> head_{0};
+  std::uint64_t cached_tail_ = 0;
+  std::atomic<std::uint64_t> dropped_{0};
+  alignas(64) std::atomic<std::uint64_t> tail_{0};
+  alignas(64) std::byte buf_[kRingBytes];
+};
+
+// Set once the writer has shut down (static destruction); later records
+// are formatted synchronously on the calling thread.
+inline std::atomic<bool> g_closed{false};
+
+class Writer {
+public:
+  static Writer &instance() {
+    static Writer w;
+    return w;
+  }
+
+  std::shared_ptr<Ring> attach() {
+    auto ring = std::make_shared<Ring>();
+    std::lock_guard lock(mu_);
+    rings_.push_back({ring, 0});
+    return ring;
+  }
+
+  ~Writer() {
+    stop_.store(true, std::memory_order_release);
+    thread_.join();
+    g_closed.store(true, std::memory_order_release);
+  }
+
+private:
+  struct Entry {
+    std::shared_ptr<Ring> ring;
+    std::uint64_t reported_drops;
+  };
+
+  Writer() : thread_([this] { run(); }) {}
+
+  void run() {
+    std::string out;
+    for (;;) {
+      // Read stop_ first so the last pass sees everything logged before it.
+      const bool stopping = stop_.load(std::memory_order_acquire);
+      const std::size_t n = drain_all(out);
+      if (!out.empty()) {
+        std::fwrite(out.data(), 1, out.size(), stderr);
+        std::fflush(stderr);
+        out.clear();
+      }
+      if (stopping) {
+        return;
+      }
+      if (n == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  }
+
+  std::size_t drain_all(std::string &out) {
+    std::lock_guard lock(mu_);
+    std::size_t n = 0;
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      Ring &ring = *it->ring;
+      const bool closed = ring.closed.load(std::memory_order_acquire);
+      n += ring.drain([&](const Header &h, const std::byte *args) {
+        format_record(out, h, args);
+      });
+      if (const auto d = ring.dropped(); d != it->reported_drops) {
+        out.append("log: ring full, dropped ");
+        out.append(std::to_string(d - it->reported_drops));
+        out.append(" records\n");
+        it->reported_drops = d;
+      }
+      it = closed ? rings_.erase(it) : it + 1;
+    }
+    return n;
+  }
+
+  std::mutex mu_;
+  std::vector<Entry> rings_;
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+struct ThreadRing {
+  std::shared_ptr<Ring> ring;
+  ~ThreadRing() {
+    if (ring) {
+      ring->closed.store(true, std::memory_order_release);
+    }
+  }
+};
+
+inline thread_local ThreadRing t_ring;
+
+// Only used unevaluated, to count macro arguments.
+template <typename... Args>
+std::integral_constant<std::size_t, sizeof...(Args)>
+arity(const Args &...) noexcept;
+
+} // namespace detail
+
+template <typename... Args>
+void emit(const Site &site, std::uint32_t suppressed, const Args &...args) {
+  static_assert(sizeof...(Args) <= kMaxArgs, "too many log arguments");
+  const std::uint64_t ts = detail::wall_ns();
+  if (!detail::g_closed.load(std::memory_order_acquire)) {
+    auto &ring = detail::t_ring.ring;
+    if (!ring) {
+      ring = detail::Writer::instance().attach();
+    }
+    ring->write(site, suppressed, ts, args...);
+    return;
+  }
+
+  alignas(8) std::byte buf[sizeof(detail::Header) +
+                           kMaxArgs * (3 + kMaxString) + 8];
+  const detail::Header h{0, suppressed, &site, ts};
+  detail::write_record(buf, h, args...);
+  std::string out;
+  detail::format_record(out, h, buf + sizeof(h));
+  std::fwrite(out.data(), 1, out.size(), stderr);
+}
+
+// Lets one record per `period_ms` through and counts the rest. Each call
+// site keeps one gate per thread.
+class RateGate {
+public:
+  bool pass(std::uint32_t period_ms, std::uint32_t &suppressed) noexcept {
+    const auto now = std::chrono::steady_clock::now();
+    if (armed_ && now - last_ < std::chrono::milliseconds(period_ms)) {
+      ++suppressed_;
+      return false;
+    }
+    armed_ = true;
+    last_ = now;
+    suppressed = std::exchange(suppressed_, 0);
+    return true;
+  }
+
+private:
+  bool armed_ = false;
+  std::chrono::steady_clock::time_point last_{};
+  std::uint32_t suppressed_ = 0;
+};
+
+} // namespace logging
+
+#define UDP_LOG_CHECK_(fmt, ...)                                               \
+  static_assert(::logging::placeholders(fmt) ==                               \
+                    decltype(::logging::detail::arity(__VA_ARGS__))::value,                     \
+                "log format placeholders do not match the arguments")
+
+#define UDP_LOG_AT(level, fmt, ...)                                            \
   do {                                                                         \
+    if constexpr (::logging::enabled(level)) {                                 \
+      UDP_LOG_CHECK_(fmt __VA_OPT__(, ) __VA_ARGS__);                          \
+      static constexpr ::logging::Site udp_log_site_{level, fmt};              \
+      ::logging::emit(udp_log_site_, 0 __VA_OPT__(, ) __VA_ARGS__);            \
+    }                                                                          \
   } while (0)
-#define UDP_LOGLN(expr)                                                        \
+
+// At most one record per `period_ms` per thread; the next one that gets
+// through reports how many were suppressed.
+#define UDP_LOG_EVERY(level, period_ms, fmt, ...)                              \
   do {                                                                         \
+    if constexpr (::logging::enabled(level)) {                                 \
+      UDP_LOG_CHECK_(fmt __VA_OPT__(, ) __VA_ARGS__);                          \
+      static constexpr ::logging::Site udp_log_site_{level, fmt};              \
+      static thread_local ::logging::RateGate udp_log_gate_;                   \
+      std::uint32_t udp_log_suppressed_ = 0;                                   \
+      if (udp_log_gate_.pass(period_ms, udp_log_suppressed_)) {                \
+        ::logging::emit(udp_log_site_,                                         \
+                        udp_log_suppressed_ __VA_OPT__(, ) __VA_ARGS__);       \
+      }                                                                        \
+    }                                                                          \
   } while (0)
-#endif
+
+#define UDP_TRACE(...) UDP_LOG_AT(::logging::Level::Trace, __VA_ARGS__)
+#define UDP_DEBUG(...) UDP_LOG_AT(::logging::Level::Debug, __VA_ARGS__)
+#define UDP_INFO(...) UDP_LOG_AT(::logging::Level::Info, __VA_ARGS__)
+#define UDP_WARN(...) UDP_LOG_AT(::logging::Level::Warn, __VA_ARGS__)
+#define UDP_ERROR(...) UDP_LOG_AT(::logging::Level::Error, __VA_ARGS__)
+#define UDP_WARN_EVERY(ms, ...)                                                \
+  UDP_LOG_EVERY(::logging::Level::Warn, ms, __VA_ARGS__)
+#define UDP_ERROR_EVERY(ms, ...)                                               \
+  UDP_LOG_EVERY(::logging::Level::Error, ms, __VA_ARGS__)
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/log.hpp"
+
+// Process-wide counters and latency histograms, readable from outside the
+// process through a POSIX shared-memory segment (tools/udp_stats).
+//
+// Every thread that records anything first calls metrics::attach(), which
+// claims a slot in the segment. From then on each counter and histogram
+// bucket has exactly one writer, so recording is a relaxed load and store
+// on a cache line no other thread writes: no locks and no atomic RMW.
+// Readers sum the slots; a torn read can only see a value one update
+// behind.
+
+namespace metrics {
+
+enum class Counter : std::uint8_t {
+  RxPackets,
+  RxBytes,
+  RxGroBuffers,
+  TxPackets,
+  TxBytes,
+  TxGsoSends,
+  ParseFailures,
+  RouterQueueFull,
+  OutboundQueueFull,
+  PayloadPoolExhausted,
+  SendSlotsExhausted,
+  SqeExhausted,
+  SendErrors,
+  RecvErrors,
+  RateLimitedEndpoint,
+  RateLimitedId,
+  ShardBusFull,
+  Evictions,
+  Count,
+};
+
+inline constexpr std::array<std::string_view,
+                            static_cast<std::size_t>(Counter::Count)>
+    kCounterNames{
+        "rx_packets",
+        "rx_bytes",
+        "rx_gro_buffers",
+        "tx_packets",
+        "tx_bytes",
+        "tx_gso_sends",
+        "parse_failures",
+        "router_queue_full",
+        "outbound_queue_full",
+        "payload_pool_exhausted",
+        "send_slots_exhausted",
+        "sqe_exhausted",
+        "send_errors",
+        "recv_errors",
+        "rate_limited_endpoint",
+        "rate_limited_id",
+        "shard_bus_full",
+        "evictions",
+    };
+
+enum class Latency : std::uint8_t {
+  RxToRouter,     // datagram reaped by the ring -> dequeued by the router
+  RouterToSubmit, // send queued by the router -> SQE prepared on the ring
+  Count,
+};
+
+inline constexpr std::array<std::string_view,
+                            static_cast<std::size_t>(Latency::Count)>
+    kLatencyNames{
+        "rx_to_router",
+        "router_to_submit",
+    };
+
+// Log-linear (HDR-style) histogram of nanosecond values: every power of two
+// is split into 8 linear sub-buckets, so any recorded value is reported
+// within 12.5%. Values from 2^41 ns (~37 min) up land in the last bucket.
+struct Histogram {
+  static constexpr unsigned kSubBits = 3;
+  static constexpr unsigned kSub = 1u << kSubBits;
+  static constexpr unsigned kMaxShift = 38;
+  static constexpr std::size_t kBuckets = (kMaxShift + 2) * kSub;
+
+  static constexpr std::size_t bucket_of(std::uint64_t v) noexcept {
+    if (v < kSub) {
+      return static_cast<std::size_t>(v);
+    }
+    const unsigned shift = std::bit_width(v) - 1 - kSubBits;
+    if (shift > kMaxShift) {
+      return kBuckets - 1;
+    }
+    return (shift + 1) * kSub + ((v >> shift) & (kSub - 1));
+  }
+
+  // Smallest value that lands in bucket `b`.
+  static constexpr std::uint64_t bucket_floor(std::size_t b) noexcept {
+    if (b < kSub) {
+      return b;
+    }
+    const std::size_t shift = b / kSub - 1;
+    return (std::uint64_t{kSub} + b % kSub) << shift;
+  }
+
+  std::array<std::atomic<std::uint64_t>, kBuckets> counts{};
+};
+
+inline constexpr std::size_t kNameLen = 32;
+
+struct alignas(64) Slot {
+  std::atomic<std::uint32_t> in_use{0};
+  char name[kNameLen]{};
+  alignas(64) std::array<std::atomic<std::uint64_t>,
+                         static_cast<std::size_t>(Counter::Count)>
+      counters{};
+  std::array<Histogram, static_cast<std::size_t>(Latency::Count)> latency{};
+};
+
+inline constexpr std::uint32_t kMagic = 0x55535431; // "UST1"
+inline constexpr std::uint32_t kVersion = 1;
+inline constexpr std::size_t kMaxSlots = 64;
+inline constexpr const char *kDefaultShmName = "/udp-uring-stats";
+
+struct Segment {
+  std::uint32_t magic;
+  std::uint32_t version;
+  std::uint32_t slots;
+  std::uint32_t slot_size;
+  std::int64_t pid;
+  std::array<Slot, kMaxSlots> slot;
+};
+
+namespace detail {
+
+// Used until open() maps the shared segment, and if it fails.
+inline Segment g_local{};
+inline std::atomic<Segment *> g_segment{&g_local};
+// Threads that never attached record here; nobody reads it.
+inline Slot g_scratch{};
+inline thread_local Slot *t_slot = &g_scratch;
+
+inline void add(std::atomic<std::uint64_t> &c, std::uint64_t n) noexcept {
+  c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+} // namespace detail
+
+// Creates (or resets) the shared-memory segment `name`. Call once at
+// startup, before any thread attaches; on failure metrics stay
+// process-local.
+//
+// The owner holds an exclusive flock on the segment for as long as it
+// runs, so a second instance started under the same name leaves the
+// first one's counters alone, while a segment left by a process that
+// exited is reset.
+inline bool open(const char *name = kDefaultShmName) {
+  const int fd = ::shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    UDP_WARN("metrics: shm_open({}) failed, stats stay local", name);
+    return false;
+  }
+  if (::flock(fd, LOCK_EX | LOCK_NB) < 0) {
+    if (errno == EWOULDBLOCK) {
+      UDP_WARN("metrics: {} is in use by another instance, stats stay local",
+               name);
+    }
+    ::close(fd);
+    return false;
+  }
+  // Only ever grow the object: a udp_stats left running from the last
+  // run still has it mapped, and shrinking it would fault that reader.
+  struct stat st{};
+  if (::fstat(fd, &st) < 0 ||
+      (static_cast<std::size_t>(st.st_size) < sizeof(Segment) &&
+       ::ftruncate(fd, sizeof(Segment)) < 0)) {
+    ::close(fd);
+    return false;
+  }
+  void *mem = ::mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+  if (mem == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  // `fd` stays open for the life of the process: closing it would drop
+  // the lock.
+
+  // Reset in place, discarding slots claimed by a previous run. The pid
+  // goes to zero first so a watching reader sees the restart before it
+  // sees the counters drop.
+  auto *seg = static_cast<Segment *>(mem);
+  std::atomic_ref<std::uint32_t>(seg->magic).store(0,
+                                                   std::memory_order_relaxed);
+  std::atomic_ref<std::int64_t>(seg->pid).store(0, std::memory_order_release);
+  std::memset(mem, 0, sizeof(Segment));
+  seg->slots = kMaxSlots;
+  seg->slot_size = sizeof(Slot);
+  seg->version = kVersion;
+  std::atomic_ref<std::int64_t>(seg->pid).store(::getpid(),
+                                                std::memory_order_release);
+  std::atomic_ref<std::uint32_t>(seg->magic).store(kMagic,
+                                                   std::memory_order_release);
+  detail::g_segment.store(seg, std::memory_order_release);
+  return true;
+}
+
+// Claims a slot for the calling thread. Threads that do not attach (or
+// find the segment full) still record, into a scratch slot.
+inline void attach(std::string_view name) noexcept {
+  Segment *seg = detail::g_segment.load(std::memory_order_acquire);
+  for (auto &slot : seg->slot) {
+    std::uint32_t expected = 0;
+    if (slot.in_use.compare_exchange_strong(expected, 1,
+                                            std::memory_order_acq_rel)) {
+      const auto n = std::min(name.size(), kNameLen - 1);
+      std::memcpy(slot.name, name.data(), n);
+      slot.name[n] = '\0';
+      detail::t_slot = &slot;
+      return;
+    }
+  }
+  UDP_WARN("metrics: no free slot for thread {}", name);
+}
+
+// Monotonic nanoseconds, the time base of every latency histogram.
+inline std::uint64_t now_ns() noexcept {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+inline void count(Counter c, std::uint64_t n = 1) noexcept {
+  detail::add(detail::t_slot->counters[static_cast<std::size_t>(c)], n);
+}
+
+inline void record(Latency h, std::uint64_t ns) noexcept {
+  auto &hist = detail::t_slot->latency[static_cast<std::size_t>(h)];
+  detail::add(hist.counts[Histogram::bucket_of(ns)], 1);
+}
+
+} // namespace metrics
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Spin-loop hint: lets the sibling hyperthread run and avoids the memory
+// order mis-speculation penalty when the spun-on line finally changes.
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// How an idle consumer waits for work. Every strategy spins first; they
+// differ in what happens once the spin budget runs out.
+enum class WaitStrategy : std::uint8_t {
+  Spin,  // keep spinning (lowest latency, burns the core)
+  Yield, // spin, then sched_yield forever
+  Park,  // spin, yield, then block until a producer calls notify()
+};
+
+// Single-consumer park/unpark. The consumer publishes `parked_` before its
+// last check for work and producers only touch the futex when it is set,
+// so a notify on the hot path costs a fence and a load, not a syscall.
+//
+// The Dekker pattern needs a full fence on both sides: the consumer stores
+// `parked_` then loads the queue indices, the producer stores the queue
+// index then loads `parked_`. Without the fences each could miss the
+// other's store and the consumer would sleep on a non-empty queue.
+class Parker {
+public:
+  // Consumer. `has_work` is re-checked after publishing the parked flag;
+  // returns once it holds or after any notify().
+  template <typename HasWork>
+  void park(HasWork &&has_work) noexcept {
+    const auto epoch = epoch_.load(std::memory_order_acquire);
+    parked_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!has_work()) {
+      epoch_.wait(epoch, std::memory_order_acquire);
+    }
+    parked_.store(false, std::memory_order_relaxed);
+  }
+
+  // Producer, after publishing work.
+  void notify() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_relaxed)) {
+      wake();
+    }
+  }
+
+  // Unconditional wakeup (shutdown).
+  void wake() noexcept {
+    epoch_.fetch_add(1, std::memory_order_release);
+    epoch_.notify_one();
+  }
+
+private:
+  alignas(64) std::atomic<std::uint32_t> epoch_{0};
+  std::atomic<bool> parked_{false};
+};
+
+// Spin -> yield -> park backoff for one idle stretch of a consumer loop.
+// Reset it whenever the consumer finds work.
+class IdleWait {
+public:
+  IdleWait(WaitStrategy strategy, std::uint32_t spins,
+           std::uint32_t yields) noexcept
+      : strategy_(strategy), spins_(spins), yields_(yields) {}
+
+  void reset() noexcept { idle_ = 0; }
+
+  template <typename HasWork>
+  void wait(Parker &parker, HasWork &&has_work) noexcept {
+    if (strategy_ == WaitStrategy::Spin || idle_ < spins_) {
+      ++idle_;
+      cpu_relax();
+    } else if (strategy_ == WaitStrategy::Yield ||
+               idle_ < spins_ + yields_) {
+      ++idle_;
+      std::this_thread::yield();
+    } else {
+      parker.park(has_work);
+    }
+  }
+
+private:
+  WaitStrategy strategy_;
+  std::uint32_t spins_;
+  std::uint32_t yields_;
+  std::uint32_t idle_ = 0;
+};
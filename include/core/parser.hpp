@@ -1,32 +1,33 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <cstring>
 #include <iostream>
 #include <optional>
 #include <span>
 
+#include "core/parser_simd.hpp"
+#include "core/wire_schema.hpp"
 #include "models/net.hpp"
 
-/*
-op - 4 bytes
-id - 4 bytes
-x - 4 bytes
-y - 4 bytes
-color - 1 bytes
-size - 4 bytes
+// Client packets are a 21- or 24-byte Players payload, bare or behind an
+// 8-byte Header, in either byte order; the layouts themselves are declared
+// in core/wire_schema.hpp.
 
-Init Packet?
+// How one sender lays out its packets. Parser reports it per packet and
+// Router remembers it per endpoint (core/format_cache.hpp) so that later
+// packets are decoded in one byte order instead of both.
+struct WireFormat {
+  std::uint8_t wire = 0;   // payload size, 21 or 24; 0 = unknown
+  bool header = false;     // preceded by a Header
+  bool header_big = false; // Header::len is big-endian
+  bool big = false;        // payload is big-endian
 
-
-*/
-
-struct Header {
-  uint8_t magic;
-  uint8_t type;
-  uint16_t len;
-  uint32_t seq;
+  [[nodiscard]] bool known() const noexcept { return wire != 0; }
+  bool operator==(const WireFormat &) const = default;
 };
 
 class Parser {
@@ -34,63 +35,202 @@ public:
   Parser() = default;
 
   std::optional<Players> parse(std::span<const std::byte> bytes) const noexcept {
-    auto payload = extract_payload(bytes);
-    if (!payload.has_value()) {
+    WireFormat format;
+    return parse(bytes, format);
+  }
+
+  // parse() for a sender whose format may already be known.
+  //
+  // On entry `format` is the format pinned for the sender, or unknown. A
+  // packet in that layout, or one whose Header declares its byte order, is
+  // decoded in that order alone; only if that gives no valid record is the
+  // other order tried. On return `format` is what the packet was decoded
+  // as when that is certain (expected, or the only byte order that passed
+  // a check), and unknown when it was a guess.
+  std::optional<Players> parse(std::span<const std::byte> bytes,
+                               WireFormat &format) const noexcept {
+    const auto at = locate(bytes, format);
+    format = {};
+    if (!at.has_value()) {
       return std::nullopt;
     }
 
-    const auto wire = payload.value();
-    if (wire.size() == kWire24) {
-      return decode24(wire);
+    if (at->expected) {
+      return decode_expected(*at, format);
+    }
+
+    const auto le = decode<std::endian::little>(at->wire);
+    const auto be = decode<std::endian::big>(at->wire);
+    bool sure = false;
+    const auto e = choose_best(le, be, sure);
+    if (!e.has_value()) {
+      return std::nullopt;
     }
-    if (wire.size() == kWire21) {
-      return decode21(wire);
+    if (sure) {
+      format = at->format;
+      format.big = *e == std::endian::big;
     }
-    return std::nullopt;
+    return *e == std::endian::big ? be : le;
   }
 
-private:
-  enum class Endian { Little, Big };
+  static constexpr std::size_t kMaxBatch = parser_simd::kMaxBatch;
 
-  static constexpr std::size_t kWire21 = 21;
-  static constexpr std::size_t kWire24 = 24;
-  static constexpr std::size_t kMaxAbsCoord = 1000000;
+  // Decodes up to kMaxBatch packets at once, with the same result as
+  // parse() on each. Bit i of the return value is set if pkts[i] parsed;
+  // only then is out[i] written. If `formats` is given, formats[i] plays
+  // the part of parse()'s `format` for pkts[i].
+  //
+  // Fields are gathered into per-field lanes here; byte order selection
+  // and coordinate validation then run over the whole batch in one
+  // parser_simd kernel (AVX2, SSE4.1 or scalar, picked at startup).
+  std::uint64_t parse_batch(std::span<const PacketView> pkts,
+                            std::span<Players> out,
+                            std::span<WireFormat> formats = {}) const noexcept {
+    const std::size_t n = std::min({pkts.size(), out.size(), kMaxBatch});
+    if (n == 0) {
+      return 0;
+    }
+    const std::size_t padded = (n + parser_simd::kLaneStep - 1) /
+                               parser_simd::kLaneStep *
+                               parser_simd::kLaneStep;
+    parser_simd::Lanes lanes;
+    std::array<std::uint8_t, kMaxBatch> color;
+    std::array<WireFormat, kMaxBatch> layout;
+    std::uint64_t present = 0;
+    std::uint64_t pinned = 0;
+    std::uint64_t pinned_big = 0;
+
+    for (std::size_t i = 0; i < padded; ++i) {
+      const auto at =
+          i < n ? locate(pkts[i].bytes,
+                         i < formats.size() ? formats[i] : WireFormat{})
+                : std::nullopt;
+      if (!at.has_value()) {
+        lanes.op[i] = lanes.id[i] = lanes.x[i] = lanes.y[i] =
+            lanes.size[i] = 0;
+        continue;
+      }
+      const auto *wire = at->wire.data();
+      lanes.op[i] = lane<&Players::op>(wire);
+      lanes.id[i] = lane<&Players::id>(wire);
+      lanes.x[i] = lane<&Players::x>(wire);
+      lanes.y[i] = lane<&Players::y>(wire);
+      lanes.size[i] = at->wire.size() == kWire24
+                          ? lane<&Players::size, Players24>(wire)
+                          : lane<&Players::size, Players21>(wire);
+      color[i] = Players24::get<&Players::color, std::endian::little>(wire);
+      layout[i] = at->format;
+      present |= std::uint64_t{1} << i;
+      if (at->expected) {
+        pinned |= std::uint64_t{1} << i;
+        if (at->format.big) {
+          pinned_big |= std::uint64_t{1} << i;
+        }
+      }
+    }
+
+    // Pinned lanes go to the kernel in their expected order; the kernel
+    // reports which lanes it swapped from there.
+    for (std::uint64_t bits = pinned_big; bits != 0; bits &= bits - 1) {
+      const auto i = static_cast<std::size_t>(std::countr_zero(bits));
+      lanes.op[i] = std::byteswap(lanes.op[i]);
+      lanes.id[i] = std::byteswap(lanes.id[i]);
+      lanes.x[i] = std::byteswap(lanes.x[i]);
+      lanes.y[i] = std::byteswap(lanes.y[i]);
+      lanes.size[i] = std::byteswap(lanes.size[i]);
+    }
+
+    parser_simd::Resolved r;
+    if (pinned == present &&
+        (parser_simd::check(lanes, padded) & present) == present) {
+      // Every sender's byte order is known and holds: nothing to resolve.
+      r.valid = present;
+    } else {
+      r = parser_simd::kernel(lanes, padded,
+                              static_cast<float>(kMaxAbsCoord), pinned);
+    }
+    const std::uint64_t ok = r.valid & present;
+    for (std::uint64_t bits = ok; bits != 0; bits &= bits - 1) {
+      const auto i = static_cast<std::size_t>(std::countr_zero(bits));
+      out[i] = Players{lanes.op[i],
+                       lanes.id[i],
+                       std::bit_cast<float>(lanes.x[i]),
+                       std::bit_cast<float>(lanes.y[i]),
+                       color[i],
+                       lanes.size[i]};
+    }
 
-  static std::uint16_t read_u16(std::span<const std::byte> bytes,
-                                std::size_t off, Endian e) noexcept {
-    const auto b0 = static_cast<std::uint8_t>(bytes[off + 0]);
-    const auto b1 = static_cast<std::uint8_t>(bytes[off + 1]);
-    if (e == Endian::Little) {
-      return static_cast<std::uint16_t>(b0 | (static_cast<std::uint16_t>(b1) << 8));
+    const std::uint64_t certain = ok & (pinned | r.sure);
+    for (std::size_t i = 0; i < std::min(n, formats.size()); ++i) {
+      formats[i] = {};
+      if ((certain >> i) & 1) {
+        formats[i] = layout[i];
+        formats[i].big = layout[i].big != (((r.swapped >> i) & 1) != 0);
+      }
     }
-    return static_cast<std::uint16_t>((static_cast<std::uint16_t>(b0) << 8) | b1);
+    return ok;
   }
 
-  static std::uint32_t read_u32(std::span<const std::byte> bytes,
-                                std::size_t off, Endian e) noexcept {
-    const auto b0 = static_cast<std::uint8_t>(bytes[off + 0]);
-    const auto b1 = static_cast<std::uint8_t>(bytes[off + 1]);
-    const auto b2 = static_cast<std::uint8_t>(bytes[off + 2]);
-    const auto b3 = static_cast<std::uint8_t>(bytes[off + 3]);
-    if (e == Endian::Little) {
-      return static_cast<std::uint32_t>(b0) |
-             (static_cast<std::uint32_t>(b1) << 8) |
-             (static_cast<std::uint32_t>(b2) << 16) |
-             (static_cast<std::uint32_t>(b3) << 24);
+  // The format a packet declares through Header::kOrderDeclared, if any.
+  static std::optional<WireFormat>
+  declared_format(std::span<const std::byte> bytes) noexcept {
+    if (bytes.size() < sizeof(Header)) {
+      return std::nullopt;
+    }
+    const auto type =
+        PacketHeader::get<&Header::type, std::endian::little>(bytes.data());
+    if ((type & Header::kOrderDeclared) == 0) {
+      return std::nullopt;
     }
-    return (static_cast<std::uint32_t>(b0) << 24) |
-           (static_cast<std::uint32_t>(b1) << 16) |
-           (static_cast<std::uint32_t>(b2) << 8) |
-           static_cast<std::uint32_t>(b3);
+    const bool big = (type & Header::kOrderBig) != 0;
+    const auto len = PacketHeader::get<&Header::len>(
+        bytes.data(), big ? std::endian::big : std::endian::little);
+    if ((len != kWire21 && len != kWire24) ||
+        bytes.size() != sizeof(Header) + len) {
+      return std::nullopt;
+    }
+    return WireFormat{static_cast<std::uint8_t>(len), true, big, big};
   }
 
-  static float read_f32(std::span<const std::byte> bytes, std::size_t off,
-                        Endian e) noexcept {
-    const auto bits = read_u32(bytes, off, e);
-    static_assert(sizeof(float) == sizeof(std::uint32_t));
-    float out = 0.0f;
-    std::memcpy(&out, &bits, sizeof(out));
-    return out;
+private:
+  using PacketHeader = wire_schema::PacketHeader;
+  using Players21 = wire_schema::Players21;
+  using Players24 = wire_schema::Players24;
+
+  static constexpr std::size_t kWire21 = Players21::size;
+  static constexpr std::size_t kWire24 = Players24::size;
+
+  // The batch gather reads op, id, x, y and color once for both payload
+  // sizes, so they have to sit at the same offsets in each.
+  static_assert(Players21::offset<&Players::op> ==
+                    Players24::offset<&Players::op> &&
+                Players21::offset<&Players::id> ==
+                    Players24::offset<&Players::id> &&
+                Players21::offset<&Players::x> ==
+                    Players24::offset<&Players::x> &&
+                Players21::offset<&Players::y> ==
+                    Players24::offset<&Players::y> &&
+                Players21::offset<&Players::color> ==
+                    Players24::offset<&Players::color>);
+  static_assert(sizeof(Header) == PacketHeader::size);
+
+  static constexpr std::size_t kMaxAbsCoord = 1000000;
+
+  // Where the payload of a packet is and how it is laid out. When
+  // `expected` is set the byte order is known in advance (pinned for the
+  // sender or declared in the Header) and `format.big` holds it; otherwise
+  // `format.big` is false and the order is left to choose_best.
+  struct Located {
+    std::span<const std::byte> wire;
+    WireFormat format;
+    bool expected = false;
+  };
+
+  // One 4-byte field of a payload as a little-endian kernel lane.
+  template <auto Member, typename Layout = Players24>
+  static std::uint32_t lane(const std::byte *wire) noexcept {
+    return wire_schema::load<std::endian::little, std::uint32_t>(
+        wire + Layout::template offset<Member>);
   }
 
   static bool valid_coords(const Players &p) noexcept {
@@ -107,91 +247,139 @@ private:
     return valid_op(p) && valid_coords(p);
   }
 
-  static Players decode24_with_endian(std::span<const std::byte> wire,
-                                      Endian e) noexcept {
-    Players p{};
-    p.op = read_u32(wire, 0, e);
-    p.id = read_u32(wire, 4, e);
-    p.x = read_f32(wire, 8, e);
-    p.y = read_f32(wire, 12, e);
-    // For the 24-byte layout, color is a standalone byte at offset 16.
-    // Offsets 17..19 are padding before size at offset 20.
-    p.color = static_cast<std::uint8_t>(wire[16]);
-    p.size = read_u32(wire, 20, e);
-    return p;
+  // Valid op and finite coordinates: the minimum for accepting a record.
+  static bool plausible(const Players &p) noexcept {
+    return valid_op(p) && std::isfinite(p.x) && std::isfinite(p.y);
+  }
+
+  // The byte order is a template argument so that each instance reads
+  // with a constant order even where it is not inlined.
+  template <std::endian E>
+  static Players decode(std::span<const std::byte> wire) noexcept {
+    return wire.size() == kWire24 ? Players24::decode<E>(wire.data())
+                                  : Players21::decode<E>(wire.data());
   }
 
-  static Players decode21_with_endian(std::span<const std::byte> wire,
-                                      Endian e) noexcept {
-    Players p{};
-    p.op = read_u32(wire, 0, e);
-    p.id = read_u32(wire, 4, e);
-    p.x = read_f32(wire, 8, e);
-    p.y = read_f32(wire, 12, e);
-    p.color = static_cast<std::uint8_t>(wire[16]);
-    p.size = read_u32(wire, 17, e);
+  static Players decode(std::span<const std::byte> wire, bool big) noexcept {
+    return big ? decode<std::endian::big>(wire)
+               : decode<std::endian::little>(wire);
+  }
+
+  // Decodes in the expected byte order, or the other one if only that
+  // gives a plausible record.
+  static std::optional<Players> decode_expected(const Located &at,
+                                                WireFormat &format) noexcept {
+    bool big = at.format.big;
+    auto p = decode(at.wire, big);
+    if (!plausible(p)) {
+      big = !big;
+      p = decode(at.wire, big);
+      if (!plausible(p)) {
+        return std::nullopt;
+      }
+    }
+    format = at.format;
+    format.big = big;
     return p;
   }
 
-  static std::optional<Players> choose_best(const Players &le,
-                                            const Players &be) noexcept {
+  // Picks the more plausible of the two decodes of one payload. `sure` is
+  // set when only one of them passes the range or the plausibility check,
+  // i.e. the pick is not a tie-break on magnitude.
+  static std::optional<std::endian> choose_best(const Players &le,
+                                           const Players &be,
+                                           bool &sure) noexcept {
     const auto le_ok = looks_sane(le);
     const auto be_ok = looks_sane(be);
+    sure = le_ok != be_ok;
 
     if (le_ok && !be_ok) {
-      return le;
+      return std::endian::little;
     }
     if (be_ok && !le_ok) {
-      return be;
+      return std::endian::big;
     }
     if (le_ok && be_ok) {
       const auto le_mag = std::fabs(le.x) + std::fabs(le.y);
       const auto be_mag = std::fabs(be.x) + std::fabs(be.y);
-      return (be_mag < le_mag) ? std::optional<Players>(be)
-                               : std::optional<Players>(le);
+      return (be_mag < le_mag) ? std::endian::big : std::endian::little;
     }
 
-    if (valid_op(le) && std::isfinite(le.x) && std::isfinite(le.y)) {
-      return le;
+    const auto le_fb = plausible(le);
+    const auto be_fb = plausible(be);
+    sure = le_fb != be_fb;
+    if (le_fb) {
+      return std::endian::little;
     }
-    if (valid_op(be) && std::isfinite(be.x) && std::isfinite(be.y)) {
-      return be;
+    if (be_fb) {
+      return std::endian::big;
     }
     return std::nullopt;
   }
 
-  static std::optional<Players> decode24(std::span<const std::byte> wire) noexcept {
-    const auto le = decode24_with_endian(wire, Endian::Little);
-    const auto be = decode24_with_endian(wire, Endian::Big);
-    return choose_best(le, be);
+  static std::optional<Located> locate(std::span<const std::byte> bytes,
+                                       const WireFormat &pinned) noexcept {
+    // Bare payloads, the common case, are kept apart from header parsing
+    // so that this part inlines into the gather loop.
+    if (bytes.size() == kWire21 || bytes.size() == kWire24) {
+      const auto wire = static_cast<std::uint8_t>(bytes.size());
+      const bool expected = !pinned.header && pinned.wire == wire;
+      return Located{bytes, expected ? pinned : WireFormat{wire}, expected};
+    }
+    return locate_header(bytes, pinned);
   }
 
-  static std::optional<Players> decode21(std::span<const std::byte> wire) noexcept {
-    const auto le = decode21_with_endian(wire, Endian::Little);
-    const auto be = decode21_with_endian(wire, Endian::Big);
-    return choose_best(le, be);
+  static std::optional<Located>
+  locate_header(std::span<const std::byte> bytes,
+                const WireFormat &pinned) noexcept {
+    if (const auto declared = declared_format(bytes)) {
+      return Located{bytes.subspan(sizeof(Header)), *declared, true};
+    }
+    if (pinned.known() && matches(bytes, pinned)) {
+      return Located{bytes.subspan(pinned.header ? sizeof(Header) : 0),
+                     pinned, true};
+    }
+    return extract_payload(bytes);
+  }
+
+  static bool matches(std::span<const std::byte> bytes,
+                      const WireFormat &f) noexcept {
+    if (!f.header) {
+      return bytes.size() == f.wire;
+    }
+    return bytes.size() == sizeof(Header) + f.wire &&
+           PacketHeader::get<&Header::len>(
+               bytes.data(),
+               f.header_big ? std::endian::big : std::endian::little) ==
+               f.wire;
   }
 
-  static std::optional<std::span<const std::byte>>
+  static std::optional<Located>
   extract_payload(std::span<const std::byte> bytes) noexcept {
     if (bytes.size() == kWire21 || bytes.size() == kWire24) {
-      return bytes;
+      return Located{bytes,
+                     {static_cast<std::uint8_t>(bytes.size()), false, false,
+                      false}};
     }
 
     if (bytes.size() >= sizeof(Header)) {
-      const auto payload_le =
-          static_cast<std::size_t>(read_u16(bytes, 2, Endian::Little));
-      const auto payload_be =
-          static_cast<std::size_t>(read_u16(bytes, 2, Endian::Big));
+      const auto payload_le = static_cast<std::size_t>(
+          PacketHeader::get<&Header::len, std::endian::little>(bytes.data()));
+      const auto payload_be = static_cast<std::size_t>(
+          PacketHeader::get<&Header::len, std::endian::big>(bytes.data()));
 
       if ((payload_le == kWire21 || payload_le == kWire24) &&
           bytes.size() == sizeof(Header) + payload_le) {
-        return bytes.subspan(sizeof(Header), payload_le);
+        return Located{bytes.subspan(sizeof(Header), payload_le),
+                       {static_cast<std::uint8_t>(payload_le), true, false,
+                        false}};
       }
 
       if ((payload_be == kWire21 || payload_be == kWire24) &&
           bytes.size() == sizeof(Header) + payload_be) {
-        return bytes.subspan(sizeof(Header), payload_be);
+        return Located{bytes.subspan(sizeof(Header), payload_be),
+                       {static_cast<std::uint8_t>(payload_be), true, true,
+                        false}};
       }
     }
 
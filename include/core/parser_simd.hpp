@@ -0,0 +1,372 @@
+#pragma once
+
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UDP_PARSER_X86 1
+#else
+#define UDP_PARSER_X86 0
+#endif
+
+// Byte-order kernels behind Parser::parse_batch.
+//
+// The batch decoder gathers the 32-bit fields of up to kMaxBatch records
+// into one array per field: in the sender's byte order where that is
+// already known (a "pinned" lane), little-endian otherwise. A kernel then
+// decodes every lane both as gathered ("le" below) and byte-swapped
+// ("be"), validates both candidates and picks one with the same rules as
+// Parser::choose_best (pinned lanes keep the gathered order unless only
+// the swapped one is valid), writing the chosen words back in place. The
+// SSE4.1 and AVX2 kernels do 4 and 8 lanes per step; the one used is
+// picked once at startup from the CPU's features.
+
+namespace parser_simd {
+
+inline constexpr std::size_t kMaxBatch = 64;
+// Kernels step 8 lanes at a time; callers zero the padding lanes.
+inline constexpr std::size_t kLaneStep = 8;
+
+struct Lanes {
+  alignas(32) std::uint32_t op[kMaxBatch];
+  alignas(32) std::uint32_t id[kMaxBatch];
+  alignas(32) std::uint32_t x[kMaxBatch];
+  alignas(32) std::uint32_t y[kMaxBatch];
+  alignas(32) std::uint32_t size[kMaxBatch];
+};
+
+// One bit per lane.
+struct Resolved {
+  std::uint64_t valid = 0;   // decoded to an acceptable record
+  std::uint64_t swapped = 0; // kept the byte-swapped candidate
+  std::uint64_t sure = 0;    // only one candidate passed some check
+};
+
+// Resolves lanes [0, n) in place (n a multiple of kLaneStep). Lanes set in
+// `pinned` keep the gathered order unless only the swapped one is valid.
+using Kernel = Resolved (*)(Lanes &, std::size_t n, float max_abs,
+                            std::uint64_t pinned) noexcept;
+
+inline Resolved resolve_scalar(Lanes &l, std::size_t n, float max_abs,
+                               std::uint64_t pinned) noexcept {
+  Resolved r;
+  for (std::size_t i = 0; i < n; ++i) {
+    const std::uint64_t bit = std::uint64_t{1} << i;
+    const std::uint32_t le[5] = {l.op[i], l.id[i], l.x[i], l.y[i], l.size[i]};
+    std::uint32_t be[5];
+    for (int f = 0; f < 5; ++f) {
+      be[f] = std::byteswap(le[f]);
+    }
+
+    const auto check = [max_abs](const std::uint32_t *w, bool &ok, bool &fb,
+                                 float &mag) {
+      const float ax = std::fabs(std::bit_cast<float>(w[2]));
+      const float ay = std::fabs(std::bit_cast<float>(w[3]));
+      const bool op = w[0] <= 2;
+      ok = op && ax <= max_abs && ay <= max_abs;
+      fb = op && ax <= FLT_MAX && ay <= FLT_MAX;
+      mag = ax + ay;
+    };
+    bool le_ok, le_fb, be_ok, be_fb;
+    float le_mag, be_mag;
+    check(le, le_ok, le_fb, le_mag);
+    check(be, be_ok, be_fb, be_mag);
+
+    const bool use_be =
+        (pinned & bit) ? !le_fb && be_fb
+        : be_ok        ? (!le_ok || be_mag < le_mag)
+                       : (!le_fb && be_fb);
+    if (use_be) {
+      l.op[i] = be[0];
+      l.id[i] = be[1];
+      l.x[i] = be[2];
+      l.y[i] = be[3];
+      l.size[i] = be[4];
+      r.swapped |= bit;
+    }
+    if (le_fb || be_fb) {
+      r.valid |= bit;
+    }
+    if (le_ok != be_ok || le_fb != be_fb) {
+      r.sure |= bit;
+    }
+  }
+  return r;
+}
+
+// Checks lanes [0, n) as gathered only, for batches where every sender's
+// byte order is already known: a bit per lane with op <= 2 and finite
+// coordinates, the bar a pinned lane has to clear to skip the swap.
+using Check = std::uint64_t (*)(const Lanes &, std::size_t n) noexcept;
+
+inline std::uint64_t check_scalar(const Lanes &l, std::size_t n) noexcept {
+  std::uint64_t valid = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    const float ax = std::fabs(std::bit_cast<float>(l.x[i]));
+    const float ay = std::fabs(std::bit_cast<float>(l.y[i]));
+    if (l.op[i] <= 2 && ax <= FLT_MAX && ay <= FLT_MAX) {
+      valid |= std::uint64_t{1} << i;
+    }
+  }
+  return valid;
+}
+
+#if UDP_PARSER_X86
+
+#define UDP_SSE41 __attribute__((target("sse4.1"), always_inline)) inline
+#define UDP_AVX2 __attribute__((target("avx2"), always_inline)) inline
+
+namespace detail {
+
+// Per-candidate checks: op <= 2 (unsigned) and |x|, |y| within `limit`.
+// NaN compares false, so it fails both the range and the finite check.
+UDP_SSE41 __m128 sse_ok(__m128i op, __m128 ax, __m128 ay, __m128 limit) {
+  const __m128i two = _mm_set1_epi32(2);
+  const __m128 op_ok =
+      _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_min_epu32(op, two), op));
+  return _mm_and_ps(op_ok, _mm_and_ps(_mm_cmple_ps(ax, limit),
+                                      _mm_cmple_ps(ay, limit)));
+}
+
+UDP_SSE41 __m128 sse_abs(__m128i v) {
+  return _mm_and_ps(_mm_castsi128_ps(v),
+                    _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+UDP_SSE41 void sse_store(std::uint32_t *p, __m128i le, __m128i be,
+                         __m128i pick) {
+  _mm_store_si128(reinterpret_cast<__m128i *>(p),
+                  _mm_blendv_epi8(le, be, pick));
+}
+
+// Lane mask `m` as bits i.. of a batch mask.
+UDP_SSE41 std::uint64_t sse_bits(__m128 m, std::size_t i) {
+  return static_cast<std::uint64_t>(_mm_movemask_ps(m)) << i;
+}
+
+UDP_AVX2 __m256 avx_ok(__m256i op, __m256 ax, __m256 ay, __m256 limit) {
+  const __m256i two = _mm256_set1_epi32(2);
+  const __m256 op_ok =
+      _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_min_epu32(op, two), op));
+  return _mm256_and_ps(op_ok,
+                       _mm256_and_ps(_mm256_cmp_ps(ax, limit, _CMP_LE_OQ),
+                                     _mm256_cmp_ps(ay, limit, _CMP_LE_OQ)));
+}
+
+UDP_AVX2 __m256 avx_abs(__m256i v) {
+  return _mm256_and_ps(_mm256_castsi256_ps(v),
+                       _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)));
+}
+
+UDP_AVX2 void avx_store(std::uint32_t *p, __m256i le, __m256i be,
+                        __m256i pick) {
+  _mm256_store_si256(reinterpret_cast<__m256i *>(p),
+                     _mm256_blendv_epi8(le, be, pick));
+}
+
+UDP_AVX2 std::uint64_t avx_bits(__m256 m, std::size_t i) {
+  return static_cast<std::uint64_t>(_mm256_movemask_ps(m)) << i;
+}
+
+} // namespace detail
+
+__attribute__((target("sse4.1"))) inline Resolved
+resolve_sse41(Lanes &l, std::size_t n, float max_abs,
+              std::uint64_t pinned) noexcept {
+  using namespace detail;
+  const __m128i swap =
+      _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128 limit = _mm_set1_ps(max_abs);
+  const __m128 finite = _mm_set1_ps(FLT_MAX);
+
+  Resolved r;
+  for (std::size_t i = 0; i < n; i += 4) {
+    const __m128i le_op =
+        _mm_load_si128(reinterpret_cast<__m128i *>(l.op + i));
+    const __m128i le_id =
+        _mm_load_si128(reinterpret_cast<__m128i *>(l.id + i));
+    const __m128i le_x =
+        _mm_load_si128(reinterpret_cast<__m128i *>(l.x + i));
+    const __m128i le_y =
+        _mm_load_si128(reinterpret_cast<__m128i *>(l.y + i));
+    const __m128i le_size =
+        _mm_load_si128(reinterpret_cast<__m128i *>(l.size + i));
+    const __m128i be_op = _mm_shuffle_epi8(le_op, swap);
+    const __m128i be_x = _mm_shuffle_epi8(le_x, swap);
+    const __m128i be_y = _mm_shuffle_epi8(le_y, swap);
+
+    const __m128 le_ax = sse_abs(le_x), le_ay = sse_abs(le_y);
+    const __m128 be_ax = sse_abs(be_x), be_ay = sse_abs(be_y);
+    const __m128 le_ok = sse_ok(le_op, le_ax, le_ay, limit);
+    const __m128 be_ok = sse_ok(be_op, be_ax, be_ay, limit);
+    const __m128 le_fb = sse_ok(le_op, le_ax, le_ay, finite);
+    const __m128 be_fb = sse_ok(be_op, be_ax, be_ay, finite);
+    const __m128 be_smaller = _mm_cmplt_ps(_mm_add_ps(be_ax, be_ay),
+                                           _mm_add_ps(le_ax, le_ay));
+
+    // be_ok ? (!le_ok || be_smaller) : (!le_fb && be_fb); a pinned lane
+    // only swaps when its gathered order is invalid, where this already
+    // reduces to be_fb.
+    const __m128 guess = _mm_or_ps(
+        _mm_and_ps(be_ok, _mm_or_ps(_mm_andnot_ps(le_ok, be_ok), be_smaller)),
+        _mm_andnot_ps(be_ok, _mm_andnot_ps(le_fb, be_fb)));
+    const __m128i pin_bits =
+        _mm_and_si128(_mm_set1_epi32(static_cast<int>((pinned >> i) & 0xf)),
+                      lane_bits);
+    const __m128 pin = _mm_castsi128_ps(_mm_cmpeq_epi32(pin_bits, lane_bits));
+    const __m128 swapped = _mm_andnot_ps(_mm_and_ps(pin, le_fb), guess);
+    const __m128i pick = _mm_castps_si128(swapped);
+
+    sse_store(l.op + i, le_op, be_op, pick);
+    sse_store(l.id + i, le_id, _mm_shuffle_epi8(le_id, swap), pick);
+    sse_store(l.x + i, le_x, be_x, pick);
+    sse_store(l.y + i, le_y, be_y, pick);
+    sse_store(l.size + i, le_size, _mm_shuffle_epi8(le_size, swap), pick);
+
+    r.valid |= sse_bits(_mm_or_ps(le_fb, be_fb), i);
+    r.swapped |= sse_bits(swapped, i);
+    r.sure |= sse_bits(
+        _mm_or_ps(_mm_xor_ps(le_ok, be_ok), _mm_xor_ps(le_fb, be_fb)), i);
+  }
+  return r;
+}
+
+__attribute__((target("avx2"))) inline Resolved
+resolve_avx2(Lanes &l, std::size_t n, float max_abs,
+             std::uint64_t pinned) noexcept {
+  using namespace detail;
+  const __m256i swap = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, //
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+  const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 limit = _mm256_set1_ps(max_abs);
+  const __m256 finite = _mm256_set1_ps(FLT_MAX);
+
+  Resolved r;
+  for (std::size_t i = 0; i < n; i += 8) {
+    const __m256i le_op =
+        _mm256_load_si256(reinterpret_cast<__m256i *>(l.op + i));
+    const __m256i le_id =
+        _mm256_load_si256(reinterpret_cast<__m256i *>(l.id + i));
+    const __m256i le_x =
+        _mm256_load_si256(reinterpret_cast<__m256i *>(l.x + i));
+    const __m256i le_y =
+        _mm256_load_si256(reinterpret_cast<__m256i *>(l.y + i));
+    const __m256i le_size =
+        _mm256_load_si256(reinterpret_cast<__m256i *>(l.size + i));
+    const __m256i be_op = _mm256_shuffle_epi8(le_op, swap);
+    const __m256i be_x = _mm256_shuffle_epi8(le_x, swap);
+    const __m256i be_y = _mm256_shuffle_epi8(le_y, swap);
+
+    const __m256 le_ax = avx_abs(le_x), le_ay = avx_abs(le_y);
+    const __m256 be_ax = avx_abs(be_x), be_ay = avx_abs(be_y);
+    const __m256 le_ok = avx_ok(le_op, le_ax, le_ay, limit);
+    const __m256 be_ok = avx_ok(be_op, be_ax, be_ay, limit);
+    const __m256 le_fb = avx_ok(le_op, le_ax, le_ay, finite);
+    const __m256 be_fb = avx_ok(be_op, be_ax, be_ay, finite);
+    const __m256 be_smaller =
+        _mm256_cmp_ps(_mm256_add_ps(be_ax, be_ay),
+                      _mm256_add_ps(le_ax, le_ay), _CMP_LT_OQ);
+
+    const __m256 guess = _mm256_or_ps(
+        _mm256_and_ps(be_ok, _mm256_or_ps(_mm256_andnot_ps(le_ok, be_ok),
+                                          be_smaller)),
+        _mm256_andnot_ps(be_ok, _mm256_andnot_ps(le_fb, be_fb)));
+    const __m256i pin_bits = _mm256_and_si256(
+        _mm256_set1_epi32(static_cast<int>((pinned >> i) & 0xff)),
+        lane_bits);
+    const __m256 pin =
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(pin_bits, lane_bits));
+    const __m256 swapped = _mm256_andnot_ps(_mm256_and_ps(pin, le_fb), guess);
+    const __m256i pick = _mm256_castps_si256(swapped);
+
+    avx_store(l.op + i, le_op, be_op, pick);
+    avx_store(l.id + i, le_id, _mm256_shuffle_epi8(le_id, swap), pick);
+    avx_store(l.x + i, le_x, be_x, pick);
+    avx_store(l.y + i, le_y, be_y, pick);
+    avx_store(l.size + i, le_size, _mm256_shuffle_epi8(le_size, swap), pick);
+
+    r.valid |= avx_bits(_mm256_or_ps(le_fb, be_fb), i);
+    r.swapped |= avx_bits(swapped, i);
+    r.sure |= avx_bits(_mm256_or_ps(_mm256_xor_ps(le_ok, be_ok),
+                                    _mm256_xor_ps(le_fb, be_fb)),
+                       i);
+  }
+  return r;
+}
+
+__attribute__((target("sse4.1"))) inline std::uint64_t
+check_sse41(const Lanes &l, std::size_t n) noexcept {
+  using namespace detail;
+  const __m128 finite = _mm_set1_ps(FLT_MAX);
+  std::uint64_t valid = 0;
+  for (std::size_t i = 0; i < n; i += 4) {
+    const __m128i op =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(l.op + i));
+    const __m128i x =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(l.x + i));
+    const __m128i y =
+        _mm_load_si128(reinterpret_cast<const __m128i *>(l.y + i));
+    valid |= sse_bits(sse_ok(op, sse_abs(x), sse_abs(y), finite), i);
+  }
+  return valid;
+}
+
+__attribute__((target("avx2"))) inline std::uint64_t
+check_avx2(const Lanes &l, std::size_t n) noexcept {
+  using namespace detail;
+  const __m256 finite = _mm256_set1_ps(FLT_MAX);
+  std::uint64_t valid = 0;
+  for (std::size_t i = 0; i < n; i += 8) {
+    const __m256i op =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(l.op + i));
+    const __m256i x =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(l.x + i));
+    const __m256i y =
+        _mm256_load_si256(reinterpret_cast<const __m256i *>(l.y + i));
+    valid |= avx_bits(avx_ok(op, avx_abs(x), avx_abs(y), finite), i);
+  }
+  return valid;
+}
+
+#undef UDP_SSE41
+#undef UDP_AVX2
+
+#endif // UDP_PARSER_X86
+
+inline Kernel select_kernel() noexcept {
+#if UDP_PARSER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return resolve_avx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return resolve_sse41;
+  }
+#endif
+  return resolve_scalar;
+}
+
+inline Check select_check() noexcept {
+#if UDP_PARSER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return check_avx2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return check_sse41;
+  }
+#endif
+  return check_scalar;
+}
+
+inline const Kernel kernel = select_kernel();
+inline const Check check = select_check();
+
+} // namespace parser_simd
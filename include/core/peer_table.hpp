@@ -0,0 +1,165 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "models/net.hpp"
+
+// id -> endpoint registry laid out for fan-out.
+//
+// Peers live in dense parallel arrays (ids, endpoints, last-seen times),
+// so sending to every peer is a linear scan over 24-byte endpoints. An
+// open-addressing index (linear probing, load factor <= 1/2) maps an id to
+// its dense position. Erase swaps the last peer into the hole and removes the index
+// slot with backward-shift deletion, so there are no tombstones and probe
+// chains never degrade.
+class PeerTable {
+public:
+  explicit PeerTable(std::size_t expected = 64) {
+    rehash(std::bit_ceil(expected < 8 ? std::size_t{16} : expected * 2));
+    ids_.reserve(expected);
+    endpoints_.reserve(expected);
+    seen_.reserve(expected);
+  }
+
+  // Inserts or updates; returns true if `id` was new. `seen` is a
+  // timestamp on the caller's clock.
+  bool upsert(std::uint32_t id, const Endpoint &ep, std::uint64_t seen = 0) {
+    std::size_t i = probe(id);
+    if (slots_[i].pos != kEmpty) {
+      endpoints_[slots_[i].pos] = ep;
+      seen_[slots_[i].pos] = seen;
+      return false;
+    }
+
+    if ((ids_.size() + 1) * 2 > slots_.size()) {
+      rehash(slots_.size() * 2);
+      i = probe(id);
+    }
+    slots_[i] = {id, static_cast<std::uint32_t>(ids_.size())};
+    ids_.push_back(id);
+    endpoints_.push_back(ep);
+    seen_.push_back(seen);
+    return true;
+  }
+
+  // Refreshes the last-seen time of a known peer.
+  bool touch(std::uint32_t id, std::uint64_t seen) noexcept {
+    const auto &slot = slots_[probe(id)];
+    if (slot.pos == kEmpty) {
+      return false;
+    }
+    seen_[slot.pos] = seen;
+    return true;
+  }
+
+  // Last `seen` passed to upsert/touch, or nullptr for an unknown id.
+  [[nodiscard]] const std::uint64_t *
+  last_seen(std::uint32_t id) const noexcept {
+    const auto &slot = slots_[probe(id)];
+    return slot.pos == kEmpty ? nullptr : &seen_[slot.pos];
+  }
+
+  [[nodiscard]] const Endpoint *find(std::uint32_t id) const noexcept {
+    const auto &slot = slots_[probe(id)];
+    return slot.pos == kEmpty ? nullptr : &endpoints_[slot.pos];
+  }
+
+  [[nodiscard]] bool contains(std::uint32_t id) const noexcept {
+    return find(id) != nullptr;
+  }
+
+  bool erase(std::uint32_t id) noexcept {
+    std::size_t i = probe(id);
+    if (slots_[i].pos == kEmpty) {
+      return false;
+    }
+
+    // Dense arrays: move the last peer into the hole.
+    const std::uint32_t pos = slots_[i].pos;
+    const std::uint32_t last = static_cast<std::uint32_t>(ids_.size() - 1);
+    if (pos != last) {
+      ids_[pos] = ids_[last];
+      endpoints_[pos] = endpoints_[last];
+      seen_[pos] = seen_[last];
+      slots_[probe(ids_[pos])].pos = pos;
+    }
+    ids_.pop_back();
+    endpoints_.pop_back();
+    seen_.pop_back();
+
+    // Index: shift later members of the probe chain back into the hole.
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t hole = i;
+    for (std::size_t j = (i + 1) & mask; slots_[j].pos != kEmpty;
+         j = (j + 1) & mask) {
+      const std::size_t home = hash(slots_[j].id) & mask;
+      // Move j if its home does not lie cyclically in (hole, j].
+      if (((j - home) & mask) >= ((j - hole) & mask)) {
+        slots_[hole] = slots_[j];
+        hole = j;
+      }
+    }
+    slots_[hole] = {};
+    return true;
+  }
+
+  void clear() noexcept {
+    ids_.clear();
+    endpoints_.clear();
+    seen_.clear();
+    for (auto &s : slots_) {
+      s = {};
+    }
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return ids_.size(); }
+  [[nodiscard]] bool empty() const noexcept { return ids_.empty(); }
+
+  // Dense views, index-aligned; invalidated by upsert/erase.
+  [[nodiscard]] std::span<const std::uint32_t> ids() const noexcept {
+    return ids_;
+  }
+  [[nodiscard]] std::span<const Endpoint> endpoints() const noexcept {
+    return endpoints_;
+  }
+
+private:
+  static constexpr std::uint32_t kEmpty = UINT32_MAX;
+
+  struct Slot {
+    std::uint32_t id = 0;
+    std::uint32_t pos = kEmpty;
+  };
+
+  static std::size_t hash(std::uint32_t id) noexcept {
+    // Fibonacci hashing; player ids are often sequential.
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> 32);
+  }
+
+  // Slot holding `id`, or the empty slot where it would go.
+  std::size_t probe(std::uint32_t id) const noexcept {
+    const std::size_t mask = slots_.size() - 1;
+    std::size_t i = hash(id) & mask;
+    while (slots_[i].pos != kEmpty && slots_[i].id != id) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+
+  void rehash(std::size_t buckets) {
+    slots_.assign(buckets, Slot{});
+    for (std::size_t pos = 0; pos < ids_.size(); ++pos) {
+      slots_[probe(ids_[pos])] = {ids_[pos], static_cast<std::uint32_t>(pos)};
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<std::uint32_t> ids_;
+  std::vector<Endpoint> endpoints_;
+  std::vector<std::uint64_t> seen_;
+};
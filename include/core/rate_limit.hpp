@@ -0,0 +1,118 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "models/net.hpp"
+
+// Token bucket in fixed point: `rate` tokens per second up to `burst`,
+// one token per packet. Times are nanoseconds on any monotonic clock;
+// rates up to ~10M/s are exact.
+struct TokenBucket {
+  static constexpr std::uint64_t kRefillCapNs = 1'000'000'000'000; // 1000 s
+
+  std::uint64_t last_ns = 0;
+  std::uint32_t tokens_milli = 0; // thousandths of a token
+
+  bool take(std::uint64_t now_ns, std::uint32_t rate,
+            std::uint32_t burst) noexcept {
+    const std::uint64_t cap = std::uint64_t{burst} * 1000;
+    if (now_ns > last_ns && rate > 0) {
+      // rate tokens/s == rate / 1e6 milli-tokens per ns. Gaps beyond
+      // kRefillCapNs refill completely (and cannot overflow the product).
+      const std::uint64_t dt = now_ns - last_ns;
+      const std::uint64_t refill =
+          dt >= kRefillCapNs ? cap : dt * rate / 1'000'000;
+      if (tokens_milli + refill >= cap) {
+        tokens_milli = static_cast<std::uint32_t>(cap);
+        last_ns = now_ns;
+      } else if (refill > 0) {
+        // Only advance by the time actually converted, so back-to-back
+        // packets shorter than one milli-token apart still accumulate.
+        tokens_milli += static_cast<std::uint32_t>(refill);
+        last_ns += refill * 1'000'000 / rate;
+      }
+    }
+    if (tokens_milli < 1000) {
+      return false;
+    }
+    tokens_milli -= 1000;
+    return true;
+  }
+};
+
+// Fixed-size table of token buckets, one per key.
+//
+// The table never allocates after construction, so a flood from many
+// (possibly spoofed) sources cannot grow it. A key that hashes onto a slot
+// held by another key takes the slot over with a full bucket; with the
+// table sized well above the number of live peers that is rare, and it
+// errs towards letting traffic through rather than punishing a
+// neighbour.
+template <typename Key, typename Hash = std::hash<Key>>
+class RateLimiter {
+public:
+  // `rate` == 0 disables the limiter.
+  RateLimiter(std::size_t slots, std::uint32_t rate, std::uint32_t burst)
+      : rate_(rate), burst_(burst < 1 ? 1 : burst),
+        mask_(std::bit_ceil(slots < 1 ? std::size_t{1} : slots) - 1),
+        slots_(rate ? mask_ + 1 : 0) {}
+
+  [[nodiscard]] bool enabled() const noexcept { return rate_ > 0; }
+
+  // True if a packet from `key` may pass; counts the ones that may not.
+  bool allow(const Key &key, std::uint64_t now_ns) noexcept {
+    if (!enabled()) {
+      return true;
+    }
+    auto &slot = slots_[Hash{}(key) & mask_];
+    if (!slot.used || !(slot.key == key)) {
+      slot.key = key;
+      slot.used = true;
+      slot.bucket = {now_ns, burst_ * 1000};
+    }
+    if (slot.bucket.take(now_ns, rate_, burst_)) {
+      return true;
+    }
+    ++dropped_;
+    return false;
+  }
+
+  [[nodiscard]] std::uint64_t dropped() const noexcept { return dropped_; }
+
+private:
+  struct Slot {
+    Key key{};
+    bool used = false;
+    TokenBucket bucket{};
+  };
+
+  std::uint32_t rate_;
+  std::uint32_t burst_;
+  std::size_t mask_;
+  std::vector<Slot> slots_;
+  std::uint64_t dropped_ = 0;
+};
+
+struct EndpointHash {
+  std::size_t operator()(const Endpoint &ep) const noexcept {
+    std::uint64_t a = 0, b = 0;
+    std::memcpy(&a, ep.addr.data(), sizeof(a));
+    std::memcpy(&b, ep.addr.data() + sizeof(a), sizeof(b));
+    std::uint64_t h = a * 0x9E3779B97F4A7C15ull;
+    h ^= (b + ep.port + (std::uint64_t{ep.scope_id} << 16)) *
+         0xC2B2AE3D27D4EB4Full;
+    return static_cast<std::size_t>(h ^ (h >> 29));
+  }
+};
+
+struct IdHash {
+  std::size_t operator()(std::uint32_t id) const noexcept {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(id) * 0x9E3779B97F4A7C15ull) >> 32);
+  }
+};
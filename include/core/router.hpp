@@ -5,62 +5,275 @@
 #include <chrono>
 #include <cstddef>
 #include <cstring>
-#include <iostream>
+#include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
+#include "core/batch.hpp"
+#include "core/delta_codec.hpp"
+#include "core/format_cache.hpp"
+#include "core/interest_grid.hpp"
 #include "core/log.hpp"
+#include "core/metrics.hpp"
 #include "core/parser.hpp"
+#include "core/peer_table.hpp"
+#include "core/rate_limit.hpp"
+#include "core/router_config.hpp"
+#include "core/shard_bus.hpp"
 #include "core/spsc.hpp"
+#include "core/timer_wheel.hpp"
 #include "models/net.hpp"
 #include "net/net_out.hpp"
 
 class Router {
 public:
-  explicit Router(INetOut &out) : out_(out), q_(kQueueCapacity) {
+  // `rx_buffers` is the number of receive buffers the driver may lend out
+  // at once; it sizes the queue that hands them back, one entry per
+  // buffer however many packets it held.
+  explicit Router(INetOut &out, const RouterConfig &cfg = {},
+                  ShardBus *bus = nullptr, std::size_t shard = 0,
+                  std::size_t rx_buffers = 0)
+      : cfg_(cfg), out_(out), grid_(cfg.interest_radius), batch_(cfg.batch_mtu),
+        delta_(cfg.delta_quant, cfg.batch_mtu), q_(kQueueCapacity),
+        released_(std::max(rx_buffers, kQueueCapacity)), bus_(bus),
+        shard_(shard), wake_(bus ? &bus->parker(shard) : &parker_),
+        idle_(cfg.idle_wait, cfg.idle_spins, cfg.idle_yields),
+        idle_ticks_(cfg.housekeeping_ms > 0
+                        ? (std::uint64_t{cfg.peer_idle_ms} +
+                           cfg.housekeeping_ms - 1) /
+                              cfg.housekeeping_ms
+                        : 0),
+        started_(std::chrono::steady_clock::now()),
+        id_limit_(cfg.id_rate_slots, cfg.id_rate, cfg.id_burst),
+        formats_(cfg.format_slots, cfg.format_learn) {}
+
+  // Starts the worker thread. The owner calls this once `out` is fully
+  // set up: from then on the worker may send, including updates other
+  // shards forward over the bus.
+  void start() {
     running_.store(true, std::memory_order_relaxed);
     worker_ = std::thread(&Router::poll, this);
   }
 
-  ~Router() noexcept {
+  // Drains what is already queued, then joins the worker. The owner calls
+  // this before tearing down anything `out` sends through; idempotent.
+  void stop() noexcept {
     running_.store(false, std::memory_order_release);
+    wake_->wake();
     if (worker_.joinable()) {
       worker_.join();
     }
   }
 
+  ~Router() noexcept { stop(); }
+
   Router(const Router &) = delete;
   Router &operator=(const Router &) = delete;
 
-  void enqueue_packet(const PacketView &pkt) noexcept {
-    if (pkt.bytes.size() > kMaxPacketBytes) {
-      UDP_LOGLN("packet too large for router queue: " << pkt.bytes.size());
+  // Driver thread: hands a received packet to the router. On false the
+  // packet was not queued and the caller still owns its buffer. Call
+  // notify() once after a batch of these.
+  bool enqueue(const RxPacket &pkt) noexcept {
+    if (!q_.push(pkt)) {
+      UDP_WARN_EVERY(1000, "router queue full: dropping packet");
+      return false;
+    }
+    return true;
+  }
+
+  // Driver thread: hands over a batch of packets with one queue publish.
+  // Returns how many were queued; the caller still owns the buffers of
+  // the rest.
+  std::size_t enqueue_n(std::span<const RxPacket> pkts) noexcept {
+    const auto n = q_.push_n(pkts.data(), pkts.size());
+    if (n < pkts.size()) {
+      UDP_WARN_EVERY(1000, "router queue full: dropping {} packets",
+                     pkts.size() - n);
+    }
+    return n;
+  }
+
+  // Driver thread: wakes the worker if it is parked.
+  void notify() noexcept { wake_->notify(); }
+
+  // Driver thread: receive buffers the router has finished with.
+  bool pop_released(RxRelease &rel) noexcept {
+    return released_.pop(rel);
+  }
+
+  // Queues a tick marker behind the packets already received, so a tick
+  // flushes exactly the updates that arrived before it.
+  void enqueue_tick() noexcept { enqueue_marker(RxPacket::Kind::Tick); }
+
+  // Driver thread: asks the worker to run on_housekeeping().
+  void enqueue_housekeeping() noexcept {
+    enqueue_marker(RxPacket::Kind::Housekeeping);
+  }
+
+  [[nodiscard]] bool tick_mode() const noexcept { return cfg_.tick_hz > 0; }
+
+  // Idle-peer eviction is on; the driver then calls on_housekeeping (or
+  // enqueue_housekeeping) every RouterConfig::housekeeping_ms.
+  [[nodiscard]] bool evicting() const noexcept { return idle_ticks_ > 0; }
+
+  // Peers evicted for inactivity since startup. Any thread.
+  [[nodiscard]] std::uint64_t evictions() const noexcept {
+    return evictions_.load(std::memory_order_relaxed);
+  }
+
+  // Advances the idle clock to wall time and evicts every peer whose
+  // last packet is older than RouterConfig::peer_idle_ms.
+  void on_housekeeping() {
+    if (!evicting()) {
       return;
     }
+    const auto elapsed = std::chrono::steady_clock::now() - started_;
+    now_ = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(elapsed)
+            .count() /
+        cfg_.housekeeping_ms);
+    idle_wheel_.advance(now_, [this](std::uint32_t id) { expire(id); });
+    publish_evictions();
+  }
 
-    QueuedPacket qp{};
-    qp.peer = pkt.peer;
-    qp.peer_len = pkt.peer_len;
-    qp.len = pkt.bytes.size();
-    if (qp.len > 0) {
-      std::memcpy(qp.bytes.data(), pkt.bytes.data(), qp.len);
+  // Sends every record that changed since the previous tick.
+  void on_tick() {
+    ++tick_;
+    if (cfg_.delta_encoding) {
+      flush_delta();
+    } else if (interest_enabled()) {
+      flush_dirty_near();
+    } else {
+      flush_dirty_all();
     }
 
-    if (!q_.push(std::move(qp))) {
-      UDP_LOGLN("router queue full: dropping packet");
+    for (auto id : dirty_) {
+      latest_[id].dirty_at = Tracked::kClean;
     }
+    dirty_.clear();
+  }
+
+  // Packets dropped by the per-id rate limit. Any thread.
+  [[nodiscard]] std::uint64_t rate_limited() const noexcept {
+    return rate_limited_.load(std::memory_order_relaxed);
   }
 
   void on_packet(const PacketView &pkt) {
-    auto decoded_opt = parser_.parse(pkt.bytes);
-    if (!decoded_opt.has_value()) {
-      UDP_LOGLN("failed to parse packet: got " << pkt.bytes.size() << " bytes");
+    on_packet(pkt, metrics::now_ns());
+  }
+
+  void on_packet(const PacketView &pkt, std::uint64_t now_ns) {
+    Endpoint ep;
+    WireFormat format;
+    if (formats_.enabled()) {
+      ep = Endpoint::from_sockaddr(*pkt.peer, pkt.peer_len);
+      format = formats_.find(ep);
+    }
+    const auto decoded = parser_.parse(pkt.bytes, format);
+    if (!decoded.has_value()) {
+      parse_failed(pkt);
+      return;
+    }
+    learn(ep, pkt, decoded.value(), format);
+    on_decoded(pkt, decoded.value(), now_ns);
+  }
+
+private:
+  static constexpr std::size_t kQueueCapacity = 1024;
+  static constexpr std::size_t kDrainBatch = 64;
+  static_assert(kDrainBatch <= Parser::kMaxBatch);
+
+  void poll() noexcept {
+    metrics::attach("router-" + std::to_string(shard_));
+    while (running_.load(std::memory_order_acquire) || !q_.empty()) {
+      const bool forwarded = poll_shards();
+
+      const std::size_t n = q_.pop_n(drain_.data(), drain_.size());
+      if (n == 0) {
+        flush_release();
+        if (forwarded) {
+          idle_.reset();
+        } else {
+          idle_.wait(*wake_, [this] { return has_work(); });
+        }
+        continue;
+      }
+      idle_.reset();
+
+      const auto now_ns = metrics::now_ns();
+      // Parse the whole drain in one batch (markers carry no bytes and
+      // simply fail to parse), then handle everything in queue order.
+      const bool learning = formats_.enabled();
+      for (std::size_t i = 0; i < n; ++i) {
+        const RxPacket &rx = drain_[i];
+        views_[i] = {rx.peer, rx.peer_len,
+                     std::span<const std::byte>(rx.data, rx.len)};
+        if (learning) {
+          peers_[i] = rx.peer ? Endpoint::from_sockaddr(*rx.peer, rx.peer_len)
+                              : Endpoint{};
+          formats_seen_[i] = formats_.find(peers_[i]);
+        }
+      }
+      const std::uint64_t parsed = parser_.parse_batch(
+          std::span<const PacketView>(views_.data(), n), decoded_,
+          learning ? std::span<WireFormat>(formats_seen_.data(), n)
+                   : std::span<WireFormat>{});
+
+      for (std::size_t i = 0; i < n; ++i) {
+        const RxPacket &rx = drain_[i];
+        if (rx.kind == RxPacket::Kind::Tick) {
+          on_tick();
+          continue;
+        }
+        if (rx.kind == RxPacket::Kind::Housekeeping) {
+          on_housekeeping();
+          continue;
+        }
+
+        metrics::record(metrics::Latency::RxToRouter, now_ns - rx.rx_ns);
+        if ((parsed >> i) & 1) {
+          learn(peers_[i], views_[i], decoded_[i], formats_seen_[i]);
+          on_decoded(views_[i], decoded_[i], now_ns);
+        } else {
+          parse_failed(views_[i]);
+        }
+        release(rx.buf);
+      }
+    }
+    flush_release();
+  }
+
+  void parse_failed(const PacketView &pkt) noexcept {
+    metrics::count(metrics::Counter::ParseFailures);
+    UDP_WARN_EVERY(1000, "failed to parse packet: got {} bytes",
+                   pkt.bytes.size());
+  }
+
+  // Feeds the format a packet was decoded as back into the cache. A
+  // register that declares its byte order pins it for the sender at once.
+  void learn(const Endpoint &ep, const PacketView &pkt, const Players &p,
+             const WireFormat &seen) noexcept {
+    if (!formats_.enabled() || ep.family == AF_UNSPEC) {
       return;
     }
-    const auto decoded = decoded_opt.value();
-    UDP_LOGLN(decoded.op << " " << decoded.id << " " << decoded.x << " "
-                         << decoded.y);
+    if (p.op == 0 && Parser::declared_format(pkt.bytes).has_value()) {
+      formats_.pin(ep, seen);
+    } else {
+      formats_.observe(ep, seen);
+    }
+  }
+
+  void on_decoded(const PacketView &pkt, const Players &decoded,
+                  std::uint64_t now_ns) {
+    if (!id_limit_.allow(decoded.id, now_ns)) {
+      rate_limited_.fetch_add(1, std::memory_order_relaxed);
+      metrics::count(metrics::Counter::RateLimitedId);
+      return;
+    }
+    UDP_TRACE("{} {} {} {}", decoded.op, decoded.id, decoded.x, decoded.y);
     switch (decoded.op) {
     case 0:
       on_register(pkt, decoded);
@@ -72,75 +285,461 @@ public:
       on_update(pkt, decoded);
       break;
     default:
-      UDP_LOGLN("Unknown OP recv");
+      UDP_WARN_EVERY(1000, "Unknown OP recv: {}", decoded.op);
       break;
     }
   }
 
-private:
-  static constexpr std::size_t kQueueCapacity = 1024;
-  static constexpr std::size_t kMaxPacketBytes = 2048;
+  void enqueue_marker(RxPacket::Kind kind) noexcept {
+    RxPacket marker{};
+    marker.kind = kind;
+    if (!q_.push(marker)) {
+      UDP_WARN_EVERY(1000, "router queue full: dropping timer marker");
+    }
+    wake_->notify();
+  }
 
-  struct QueuedPacket {
-    sockaddr_storage peer{};
-    socklen_t peer_len{};
-    std::array<std::byte, kMaxPacketBytes> bytes{};
-    std::size_t len{};
-  };
+  bool has_work() noexcept {
+    return !q_.empty() || !running_.load(std::memory_order_acquire) ||
+           (bus_ && bus_->has_incoming(shard_));
+  }
 
-  void poll() noexcept {
-    while (running_.load(std::memory_order_acquire) || !q_.empty()) {
-      QueuedPacket qp{};
-      if (!q_.pop(qp)) {
-        std::this_thread::sleep_for(std::chrono::microseconds(50));
+  // Packets from one receive buffer (the segments of a GRO read) reach the
+  // queue in a single driver publish, so they arrive back to back and are
+  // returned together: one release per buffer, which is what released_
+  // is sized for. The run is held until a packet from another buffer
+  // shows up or the queue runs dry.
+  void release(std::uint16_t buf) noexcept {
+    if (buf == RxPacket::kNoBuffer) {
+      return;
+    }
+    if (buf == pending_release_.buf) {
+      ++pending_release_.refs;
+      return;
+    }
+    flush_release();
+    pending_release_ = {buf, 1};
+  }
+
+  void flush_release() noexcept {
+    if (pending_release_.refs == 0) {
+      return;
+    }
+    if (!released_.push(pending_release_)) {
+      UDP_ERROR_EVERY(1000, "release queue full: leaking receive buffer {}",
+                      pending_release_.buf);
+    }
+    pending_release_ = {};
+  }
+
+  // Drains fan-out forwarded by the other shards' routers.
+  bool poll_shards() noexcept {
+    if (!bus_) {
+      return false;
+    }
+
+    bool any = false;
+    for (std::size_t from = 0; from < bus_->shards(); ++from) {
+      if (from == shard_) {
         continue;
       }
+      auto &lane = bus_->lane(from, shard_);
+      while (lane.pop(fwd_)) {
+        any = true;
+        if (fwd_.kind == ShardMsg::Kind::Evict) {
+          forget_forwarded(fwd_.player.id);
+        } else if (tick_mode()) {
+          stage(fwd_.player);
+        } else if (fwd_.player.op == 1) {
+          broadcast_near(fwd_.player, fwd_.bytes.data(), fwd_.len);
+        } else {
+          broadcast_all(fwd_.bytes.data(), fwd_.len);
+        }
+      }
+    }
+    return any;
+  }
+
+  // Hands a locally received update to the other shards, which fan it out
+  // to the peers whose sockets they own.
+  void forward(const PacketView &pkt, const Players &p) noexcept {
+    if (bus_ && bus_->publish(shard_, p, pkt.bytes) > 0) {
+      metrics::count(metrics::Counter::ShardBusFull);
+      UDP_WARN_EVERY(1000, "shard bus full: dropped forwarded update for {}",
+                     p.id);
+    }
+  }
+
+  bool interest_enabled() const noexcept { return cfg_.interest_radius > 0; }
 
-      PacketView pkt{
-          qp.peer,
-          qp.peer_len,
-          std::span<const std::byte>(qp.bytes.data(), qp.len),
-      };
-      on_packet(pkt);
+  void track(const PacketView &pkt, const Players &p) {
+    const auto ep = Endpoint::from_sockaddr(*pkt.peer, pkt.peer_len);
+    if (ep.family == AF_UNSPEC) {
+      UDP_WARN_EVERY(1000, "ignoring player {}: unsupported address family",
+                     p.id);
+      return;
+    }
+    if (players_.upsert(p.id, ep, now_) && evicting()) {
+      idle_wheel_.schedule(p.id, now_ + idle_ticks_);
+    }
+    if (interest_enabled()) {
+      grid_.update(p.id, p.x, p.y);
     }
   }
 
   void on_register(const PacketView &pkt, const Players &p) {
-    players_[p.id] = {pkt.peer, pkt.peer_len};
-    UDP_LOGLN("Player added: " << p.id << " " << p.op);
+    track(pkt, p);
+    UDP_DEBUG("Player added: {} {}", p.id, p.op);
     // Register is a control message for server state; do not rebroadcast as op=0.
   }
 
   void on_player(const PacketView &pkt, const Players &p) {
-    players_[p.id] = {pkt.peer, pkt.peer_len};
-    UDP_LOGLN("Player packet: " << p.id);
-    broadcast_all(pkt.bytes.data(), pkt.bytes.size());
+    track(pkt, p);
+    UDP_TRACE("Player packet: {}", p.id);
+    if (tick_mode()) {
+      stage(p);
+    } else {
+      broadcast_near(p, pkt.bytes.data(), pkt.bytes.size());
+    }
+    forward(pkt, p);
+  }
+
+  // Tick mode: remember the newest state for the id; intermediate states
+  // overwritten before the next tick are never sent.
+  void stage(const Players &p) {
+    auto &t = latest_[p.id];
+    t.player = p;
+    if (t.dirty_at == Tracked::kClean) {
+      t.dirty_at = static_cast<uint32_t>(dirty_.size());
+      dirty_.push_back(p.id);
+    }
+  }
+
+  // Every peer sees the same changes: build each datagram once and share
+  // it across the whole fan-out.
+  void flush_dirty_all() {
+    if (dirty_.empty() || players_.empty()) {
+      return;
+    }
+
+    batch_.begin(tick_);
+    for (auto id : dirty_) {
+      if (batch_.full()) {
+        send_batch_all();
+      }
+      batch_.add(latest_[id].player);
+    }
+    send_batch_all();
+    out_.flush();
+  }
+
+  void send_batch_all() {
+    const auto bytes = batch_.finish();
+    out_.send_to_all(players_.endpoints(), bytes.data(), bytes.size());
+    batch_.begin(tick_);
+  }
+
+  // Buckets `ids` by the peers whose interest radius covers them.
+  void collect_near(const std::vector<uint32_t> &ids) {
+    for (auto &[peer_id, records] : pending_) {
+      records.clear();
+    }
+    for (auto id : ids) {
+      const auto &p = latest_[id].player;
+      grid_.for_each_near(p.x, p.y, cfg_.interest_radius,
+                          [&](uint32_t peer_id) {
+                            pending_[peer_id].push_back(id);
+                          });
+    }
+  }
+
+  // Each peer only gets the changed records within its interest radius.
+  void flush_dirty_near() {
+    if (dirty_.empty()) {
+      return;
+    }
+    collect_near(dirty_);
+
+    for (auto const &[peer_id, records] : pending_) {
+      const Endpoint *peer = players_.find(peer_id);
+      if (records.empty() || !peer) {
+        continue;
+      }
+
+      batch_.begin(tick_);
+      for (auto id : records) {
+        if (batch_.full()) {
+          const auto bytes = batch_.finish();
+          out_.send_to(*peer, bytes.data(), bytes.size());
+          batch_.begin(tick_);
+        }
+        batch_.add(latest_[id].player);
+      }
+      const auto bytes = batch_.finish();
+      out_.send_to(*peer, bytes.data(), bytes.size());
+    }
+    out_.flush();
+  }
+
+  // Fans an op=1 update out to the peers within the interest radius of the
+  // player it describes, or to everyone when interest management is off.
+  void broadcast_near(const Players &p, const void *data, size_t len) {
+    if (!interest_enabled()) {
+      broadcast_all(data, len);
+      return;
+    }
+
+    fanout_.clear();
+    grid_.for_each_near(p.x, p.y, cfg_.interest_radius, [&](uint32_t id) {
+      if (const Endpoint *peer = players_.find(id)) {
+        fanout_.push_back(*peer);
+      }
+    });
+    out_.send_to_all(fanout_, data, len);
+    out_.flush();
   }
 
   void broadcast_all(const void *data, size_t len) {
-    for (auto const &[id, peer] : players_) {
-      out_.send_to(peer.addr, peer.len, data, len);
+    out_.send_to_all(players_.endpoints(), data, len);
+    out_.flush();
+  }
+
+  void broadcast_all_except(const void *data, size_t len, uint32_t pid) {
+    fanout_.clear();
+    const auto ids = players_.ids();
+    const auto peers = players_.endpoints();
+    for (size_t i = 0; i < ids.size(); ++i) {
+      if (ids[i] != pid) {
+        fanout_.push_back(peers[i]);
+      }
+    }
+    out_.send_to_all(fanout_, data, len);
+    out_.flush();
+  }
+
+  // Per-peer delta datagrams. Keyframe ticks resend every known record in
+  // absolute form; other ticks only encode what changed since the peer's
+  // baseline.
+  void flush_delta() {
+    const bool keyframe = cfg_.delta_keyframe_ticks > 0 &&
+                          tick_ % cfg_.delta_keyframe_ticks == 0;
+    const std::vector<uint32_t> *ids = &dirty_;
+    if (keyframe) {
+      keyframe_ids_.clear();
+      for (auto const &[id, t] : latest_) {
+        keyframe_ids_.push_back(id);
+      }
+      ids = &keyframe_ids_;
+    }
+    if (ids->empty()) {
+      return;
+    }
+
+    if (interest_enabled()) {
+      collect_near(*ids);
+      for (auto const &[peer_id, records] : pending_) {
+        if (!records.empty()) {
+          send_delta(peer_id, records, keyframe);
+        }
+      }
+    } else {
+      for (auto peer_id : players_.ids()) {
+        send_delta(peer_id, *ids, keyframe);
+      }
+    }
+    out_.flush();
+  }
+
+  void send_delta(uint32_t peer_id, const std::vector<uint32_t> &records,
+                  bool keyframe) {
+    const Endpoint *peer = players_.find(peer_id);
+    if (!peer) {
+      return;
+    }
+    auto &base = baselines_[peer_id];
+
+    delta_.begin(tick_);
+    for (auto id : records) {
+      const auto &p = latest_[id].player;
+      if (!add_delta(p, base, peer_id, keyframe)) {
+        const auto bytes = delta_.finish();
+        out_.send_to(*peer, bytes.data(), bytes.size());
+        delta_.begin(tick_);
+        add_delta(p, base, peer_id, keyframe);
+      }
+    }
+    if (!delta_.empty()) {
+      const auto bytes = delta_.finish();
+      out_.send_to(*peer, bytes.data(), bytes.size());
+    }
+  }
+
+  // DeltaEncoder::add that notes in holders_ when `peer_id`'s baseline
+  // gains an entry for the record.
+  bool add_delta(const Players &p, DeltaBaseline &base, uint32_t peer_id,
+                 bool keyframe) {
+    const auto held = base.size();
+    const bool ok = delta_.add(p, base, keyframe);
+    if (base.size() != held) {
+      holders_[p.id].insert(peer_id);
+    }
+    return ok;
+  }
+
+  // Lazy rescheduling: a peer's wheel entry is only moved when it fires,
+  // so refreshing last-seen on every packet costs one array store.
+  void expire(std::uint32_t id) {
+    const std::uint64_t *seen = players_.last_seen(id);
+    if (!seen) {
+      return;
+    }
+    if (*seen + idle_ticks_ > now_) {
+      idle_wheel_.schedule(id, *seen + idle_ticks_);
+      return;
+    }
+    evict(id);
+  }
+
+  void evict(std::uint32_t id) {
+    if (const Endpoint *peer = players_.find(id)) {
+      formats_.forget(*peer);
+    }
+    players_.erase(id);
+    if (interest_enabled()) {
+      grid_.remove(id);
+    }
+    pending_.erase(id);
+    drop_baseline(id);
+    forget_record(id);
+    // Other shards staged this player's forwarded updates in tick mode.
+    if (bus_ && tick_mode()) {
+      evicted_.push_back(id);
     }
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    metrics::count(metrics::Counter::Evictions);
+    UDP_DEBUG("evicted idle player {}", id);
   }
 
-  void broadcast_all_except(const void *data, size_t len, int pid) {
-    for (auto const &[id, peer] : players_) {
-      if (id != pid) {
-        out_.send_to(peer.addr, peer.len, data, len);
+  // Drops what was sent to `peer_id`. Each baseline entry is removed from
+  // holders_ once, so the cost is paid back by the sends that made it.
+  void drop_baseline(std::uint32_t peer_id) {
+    const auto it = baselines_.find(peer_id);
+    if (it == baselines_.end()) {
+      return;
+    }
+    for (const auto &[id, state] : it->second) {
+      if (auto h = holders_.find(id); h != holders_.end()) {
+        h->second.erase(peer_id);
+        if (h->second.empty()) {
+          holders_.erase(h);
+        }
+      }
+    }
+    baselines_.erase(it);
+  }
+
+  // Drops the tick state kept for `id` as a record other peers receive:
+  // only the baselines that hold it are touched, and it leaves dirty_ by
+  // swapping with the last entry.
+  void forget_record(std::uint32_t id) {
+    if (auto h = holders_.find(id); h != holders_.end()) {
+      for (auto peer_id : h->second) {
+        if (auto b = baselines_.find(peer_id); b != baselines_.end()) {
+          b->second.erase(id);
+        }
+      }
+      holders_.erase(h);
+    }
+    if (auto it = latest_.find(id); it != latest_.end()) {
+      if (const auto at = it->second.dirty_at; at != Tracked::kClean) {
+        const auto last = dirty_.back();
+        dirty_[at] = last;
+        latest_[last].dirty_at = at;
+        dirty_.pop_back();
       }
+      latest_.erase(it);
     }
   }
 
+  // Another shard evicted `id`. Ignored if the id has since registered
+  // here, in which case the record is ours.
+  void forget_forwarded(std::uint32_t id) {
+    if (!players_.find(id)) {
+      forget_record(id);
+    }
+  }
+
+  // Sends the evictions of this housekeeping pass to the other shards. A
+  // notice a full lane refused is kept and sent again on the next pass,
+  // unless the player has registered again meanwhile.
+  void publish_evictions() {
+    std::erase_if(evicted_, [this](std::uint32_t id) {
+      if (players_.find(id) || bus_->publish_evict(shard_, id) == 0) {
+        return true;
+      }
+      metrics::count(metrics::Counter::ShardBusFull);
+      return false;
+    });
+  }
+
   void on_update(const PacketView &pkt, const Players &p) {
-    UDP_LOGLN("Sending data...");
-    (void)p;
-    broadcast_all(pkt.bytes.data(), pkt.bytes.size());
+    UDP_TRACE("Sending data...");
+    players_.touch(p.id, now_);
+    if (tick_mode()) {
+      stage(p);
+    } else {
+      broadcast_all(pkt.bytes.data(), pkt.bytes.size());
+    }
+    forward(pkt, p);
   }
 
+  RouterConfig cfg_;
   Parser parser_;
   INetOut &out_;
-  std::unordered_map<uint32_t, PeerInfo> players_;
-  SPSC<QueuedPacket> q_;
+  PeerTable players_;
+  InterestGrid grid_;
+
+  struct Tracked {
+    static constexpr uint32_t kClean = UINT32_MAX;
+
+    Players player{};
+    uint32_t dirty_at = kClean; // index in dirty_ while changed this tick
+  };
+  std::unordered_map<uint32_t, Tracked> latest_; // tick mode: newest per id
+  std::vector<uint32_t> dirty_;                  // ids changed this tick
+  std::unordered_map<uint32_t, std::vector<uint32_t>> pending_; // peer -> ids
+  BatchWriter batch_;
+  DeltaEncoder delta_;
+  std::unordered_map<uint32_t, DeltaBaseline> baselines_; // peer -> sent
+  // Record id -> peers whose baseline holds it, so forgetting a record
+  // only visits those baselines.
+  std::unordered_map<uint32_t, std::unordered_set<uint32_t>> holders_;
+  std::vector<uint32_t> keyframe_ids_;
+  uint32_t tick_ = 0;
+  std::vector<Endpoint> fanout_; // scratch destination list, reused
+  TimerWheel idle_wheel_;
+  std::uint64_t now_ = 0; // housekeeping ticks since startup
+  SPSC<RxPacket> q_;
+  std::array<RxPacket, kDrainBatch> drain_{};
+  std::array<PacketView, kDrainBatch> views_{};
+  std::array<Players, kDrainBatch> decoded_{};
+  std::array<Endpoint, kDrainBatch> peers_{};
+  std::array<WireFormat, kDrainBatch> formats_seen_{};
+  SPSC<RxRelease> released_;
+  RxRelease pending_release_{}; // run of packets from one buffer
+  ShardBus *bus_ = nullptr;
+  std::size_t shard_ = 0;
+  ShardMsg fwd_{};
   std::atomic<bool> running_{false};
+  Parker parker_; // used when there is no bus
+  Parker *wake_;
+  IdleWait idle_;
+  std::uint64_t idle_ticks_;
+  std::chrono::steady_clock::time_point started_;
+  std::atomic<std::uint64_t> evictions_{0};
+  std::vector<std::uint32_t> evicted_; // not yet announced on the bus
+  RateLimiter<std::uint32_t, IdHash> id_limit_;
+  std::atomic<std::uint64_t> rate_limited_{0};
+  FormatCache formats_;
   std::thread worker_;
 };
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "core/parker.hpp"
+
+struct RouterConfig {
+  // op=1 updates only fan out to peers within this distance of the sender
+  // (0 disables interest management and broadcasts to every peer).
+  float interest_radius = 0.0f;
+
+  // Tick mode: op=1/op=2 updates are not rebroadcast as they arrive.
+  // Instead the latest state per id is kept and, tick_hz times a second,
+  // every changed record is packed into batched datagrams (core/batch.hpp).
+  // 0 keeps immediate per-packet rebroadcast.
+  std::uint32_t tick_hz = 0;
+  // Upper bound on one batched datagram, header included. The io_uring
+  // driver caps it at its send payload size (SharedPayload::kMax).
+  std::size_t batch_mtu = 1200;
+
+  // Tick mode only: send each peer quantized deltas against the state it
+  // was last sent (core/delta_codec.hpp) instead of full 24-byte records.
+  bool delta_encoding = false;
+  // Coordinate quantization step in world units.
+  float delta_quant = 1.0f / 64.0f;
+  // Every this many ticks, send every known record in absolute form so a
+  // peer that lost a datagram resynchronises (0 disables keyframes).
+  std::uint32_t delta_keyframe_ticks = 60;
+
+  // Peers not heard from for this long are dropped from fan-out
+  // (0 keeps them forever). Checked every `housekeeping_ms`, which is also
+  // the granularity of the idle clock.
+  std::uint32_t peer_idle_ms = 30'000;
+  std::uint32_t housekeeping_ms = 100;
+
+  // Token bucket per player id, checked right after parsing so one id
+  // cannot turn a packet flood into fan-out: `id_rate` packets/s with
+  // bursts of `id_burst` (0 rate disables).
+  std::uint32_t id_rate = 250;
+  std::uint32_t id_burst = 500;
+  std::size_t id_rate_slots = 8192;
+
+  // Per-sender wire format cache (core/format_cache.hpp): once a source
+  // endpoint's packets have decoded unambiguously in the same layout and
+  // byte order `format_learn` times in a row, its packets are decoded in
+  // that order alone instead of both. An op=0 register whose Header
+  // declares its byte order pins the format at once. 0 disables.
+  std::uint32_t format_learn = 4;
+  std::size_t format_slots = 8192;
+
+  // What the worker does when its queues are empty: spin `idle_spins`
+  // times, then yield `idle_yields` times, then (Park) block until the
+  // driver or another shard hands it work.
+  WaitStrategy idle_wait = WaitStrategy::Park;
+  std::uint32_t idle_spins = 2000;
+  std::uint32_t idle_yields = 64;
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "core/parker.hpp"
+#include "core/spsc.hpp"
+#include "models/net.hpp"
+
+// Fan-out forwarded from the shard that received a packet to every other
+// shard, so each shard only ever sends to the peers it owns. An Evict
+// message carries no bytes: the shard owning `player.id` dropped it, and
+// the others forget the state they were forwarded for it.
+struct ShardMsg {
+  static constexpr std::size_t kMaxBytes = 64;
+
+  enum class Kind : std::uint8_t { Update, Evict };
+
+  Kind kind = Kind::Update;
+  Players player{};
+  std::uint8_t len = 0;
+  std::array<std::byte, kMaxBytes> bytes{};
+};
+
+// Full mesh of SPSC lanes, one per (from, to) shard pair. Each lane has a
+// single producer (the router of `from`) and a single consumer (the router
+// of `to`), so no lane needs more than the plain SPSC guarantees.
+class ShardBus {
+public:
+  explicit ShardBus(std::size_t shards, std::size_t capacity = kLaneCapacity)
+      : shards_(shards < 1 ? 1 : shards),
+        parkers_(std::make_unique<Parker[]>(shards_)) {
+    lanes_.reserve(shards_ * shards_);
+    for (std::size_t i = 0; i < shards_ * shards_; ++i) {
+      lanes_.push_back(std::make_unique<SPSC<ShardMsg>>(capacity));
+    }
+  }
+
+  ShardBus(const ShardBus &) = delete;
+  ShardBus &operator=(const ShardBus &) = delete;
+
+  [[nodiscard]] std::size_t shards() const noexcept { return shards_; }
+
+  // Returns the number of shards the message could not be delivered to.
+  std::size_t publish(std::size_t from, const Players &p,
+                      std::span<const std::byte> bytes) noexcept {
+    if (shards_ < 2) {
+      return 0;
+    }
+    if (bytes.size() > ShardMsg::kMaxBytes) {
+      return shards_ - 1;
+    }
+
+    ShardMsg msg{};
+    msg.player = p;
+    msg.len = static_cast<std::uint8_t>(bytes.size());
+    std::memcpy(msg.bytes.data(), bytes.data(), bytes.size());
+    return send(from, msg);
+  }
+
+  // Tells every other shard that `id` was evicted. Returns the number of
+  // shards that did not get it; sending it again is harmless.
+  std::size_t publish_evict(std::size_t from, std::uint32_t id) noexcept {
+    if (shards_ < 2) {
+      return 0;
+    }
+    ShardMsg msg{};
+    msg.kind = ShardMsg::Kind::Evict;
+    msg.player.id = id;
+    return send(from, msg);
+  }
+
+  // Owned by the bus rather than the routers so a shard can still wake a
+  // neighbour whose router is being torn down.
+  Parker &parker(std::size_t shard) noexcept { return parkers_[shard]; }
+
+  [[nodiscard]] bool has_incoming(std::size_t to) noexcept {
+    for (std::size_t from = 0; from < shards_; ++from) {
+      if (from != to && !lane(from, to).empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  SPSC<ShardMsg> &lane(std::size_t from, std::size_t to) noexcept {
+    return *lanes_[from * shards_ + to];
+  }
+
+private:
+  static constexpr std::size_t kLaneCapacity = 1024;
+
+  std::size_t send(std::size_t from, const ShardMsg &msg) noexcept {
+    std::size_t dropped = 0;
+    for (std::size_t to = 0; to < shards_; ++to) {
+      if (to == from) {
+        continue;
+      }
+      if (lane(from, to).push(msg)) {
+        parkers_[to].notify();
+      } else {
+        ++dropped;
+      }
+    }
+    return dropped;
+  }
+
+  std::size_t shards_;
+  std::unique_ptr<Parker[]> parkers_;
+  std::vector<std::unique_ptr<SPSC<ShardMsg>>> lanes_;
+};
@@ -1,68 +1,130 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cstddef>
 #include <memory>
 #include <utility>
 
+// Bounded single-producer/single-consumer ring.
+//
+// Indices grow monotonically and are masked into a power-of-two buffer, so
+// every slot is usable and there is no modulo on the hot path. Each side
+// keeps a cached copy of the other side's index and only reloads it (with
+// acquire, pulling the remote cache line over) when the cached value says
+// the ring is full/empty. push_n/pop_n move a whole batch per index
+// update.
 template <typename T>
 class SPSC {
 public:
+  // Rounds `capacity` up to a power of two.
   explicit SPSC(std::size_t capacity)
-      : capacity_(capacity < 2 ? 2 : capacity),
-        buf_(std::make_unique<T[]>(capacity_)) {}
+      : mask_(std::bit_ceil(capacity < 2 ? std::size_t{2} : capacity) - 1),
+        buf_(std::make_unique<T[]>(mask_ + 1)) {}
+
+  SPSC(const SPSC &) = delete;
+  SPSC &operator=(const SPSC &) = delete;
 
   bool push(const T &item) noexcept {
     const auto write_idx = write_idx_.load(std::memory_order_relaxed);
-    const auto read_idx = read_idx_.load(std::memory_order_acquire);
-    const auto next = (write_idx + 1) % capacity_;
-
-    if (next == read_idx) {
+    if (!writable(write_idx, 1)) {
       return false;
     }
 
-    buf_[write_idx] = item;
-    write_idx_.store(next, std::memory_order_release);
+    buf_[write_idx & mask_] = item;
+    write_idx_.store(write_idx + 1, std::memory_order_release);
     return true;
   }
 
   bool push(T &&item) noexcept {
     const auto write_idx = write_idx_.load(std::memory_order_relaxed);
-    const auto read_idx = read_idx_.load(std::memory_order_acquire);
-    const auto next = (write_idx + 1) % capacity_;
-
-    if (next == read_idx) {
+    if (!writable(write_idx, 1)) {
       return false;
     }
 
-    buf_[write_idx] = std::move(item);
-    write_idx_.store(next, std::memory_order_release);
+    buf_[write_idx & mask_] = std::move(item);
+    write_idx_.store(write_idx + 1, std::memory_order_release);
     return true;
   }
 
+  // Pushes up to `n` items with one index publish. Returns how many fit.
+  std::size_t push_n(const T *items, std::size_t n) noexcept {
+    const auto write_idx = write_idx_.load(std::memory_order_relaxed);
+    writable(write_idx, n);
+    n = std::min(n, capacity() - (write_idx - cached_read_));
+    if (n == 0) {
+      return 0;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+      buf_[(write_idx + i) & mask_] = items[i];
+    }
+    write_idx_.store(write_idx + n, std::memory_order_release);
+    return n;
+  }
+
   bool pop(T &item) noexcept {
-    const auto write_idx = write_idx_.load(std::memory_order_acquire);
     const auto read_idx = read_idx_.load(std::memory_order_relaxed);
-
-    if (read_idx == write_idx) {
+    if (!readable(read_idx, 1)) {
       return false;
     }
 
-    item = std::move(buf_[read_idx]);
-    const auto next = (read_idx + 1) % capacity_;
-    read_idx_.store(next, std::memory_order_release);
+    item = std::move(buf_[read_idx & mask_]);
+    read_idx_.store(read_idx + 1, std::memory_order_release);
     return true;
   }
 
+  // Pops up to `max` items with one index publish. Returns how many.
+  std::size_t pop_n(T *out, std::size_t max) noexcept {
+    const auto read_idx = read_idx_.load(std::memory_order_relaxed);
+    readable(read_idx, max);
+    const std::size_t n = std::min(max, cached_write_ - read_idx);
+    if (n == 0) {
+      return 0;
+    }
+
+    for (std::size_t i = 0; i < n; ++i) {
+      out[i] = std::move(buf_[(read_idx + i) & mask_]);
+    }
+    read_idx_.store(read_idx + n, std::memory_order_release);
+    return n;
+  }
+
   [[nodiscard]] bool empty() const noexcept {
     const auto read_idx = read_idx_.load(std::memory_order_relaxed);
     const auto write_idx = write_idx_.load(std::memory_order_relaxed);
     return read_idx == write_idx;
   }
 
+  [[nodiscard]] std::size_t capacity() const noexcept { return mask_ + 1; }
+
 private:
-  std::size_t capacity_;
+  // Producer: true if `n` slots are free, refreshing the cached read index
+  // only when the cached one is not enough.
+  bool writable(std::size_t write_idx, std::size_t n) noexcept {
+    if (capacity() - (write_idx - cached_read_) >= n) {
+      return true;
+    }
+    cached_read_ = read_idx_.load(std::memory_order_acquire);
+    return capacity() - (write_idx - cached_read_) >= n;
+  }
+
+  // Consumer: true if `n` items are ready, same caching as writable().
+  bool readable(std::size_t read_idx, std::size_t n) noexcept {
+    if (cached_write_ - read_idx >= n) {
+      return true;
+    }
+    cached_write_ = write_idx_.load(std::memory_order_acquire);
+    return cached_write_ - read_idx >= n;
+  }
+
+  std::size_t mask_;
   std::unique_ptr<T[]> buf_;
+  // Consumer line: its index plus its view of the producer's.
   alignas(64) std::atomic<std::size_t> read_idx_{0};
+  std::size_t cached_write_ = 0;
+  // Producer line.
   alignas(64) std::atomic<std::size_t> write_idx_{0};
+  std::size_t cached_read_ = 0;
 };
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel over an integer tick clock.
+//
+// Four levels of 64 slots cover 2^24 ticks; level L slot i holds entries
+// whose deadline falls in the i-th 64^L-tick block. advance() fires level 0
+// one slot per tick and, whenever the lower bits of the clock wrap,
+// cascades the matching higher-level slot down. Each entry is touched once
+// per level it passes through, so the cost per tick is O(1) amortized
+// regardless of how many timers are pending.
+//
+// There is no cancel: callers that push a deadline back leave the old entry
+// in place and re-check when it fires (see Router::on_housekeeping).
+class TimerWheel {
+public:
+  explicit TimerWheel(std::uint64_t now = 0) : now_(now) {}
+
+  [[nodiscard]] std::uint64_t now() const noexcept { return now_; }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+
+  // Deadlines at or before now() fire on the next tick; deadlines beyond
+  // the wheel's range are clamped to it.
+  void schedule(std::uint32_t id, std::uint64_t deadline) {
+    if (deadline <= now_) {
+      deadline = now_ + 1;
+    }
+    if (deadline - now_ >= kRange) {
+      deadline = now_ + kRange - 1;
+    }
+    place({id, deadline});
+    ++size_;
+  }
+
+  // Moves the clock to `to`, calling expired(id) for every entry whose
+  // deadline passes. expired may call schedule().
+  template <typename Expired>
+  void advance(std::uint64_t to, Expired &&expired) {
+    while (now_ < to) {
+      ++now_;
+      for (std::size_t level = kLevels - 1; level > 0; --level) {
+        if ((now_ & ((std::uint64_t{1} << (kBits * level)) - 1)) == 0) {
+          cascade(level);
+        }
+      }
+
+      auto &slot = slots_[0][now_ & kMask];
+      if (slot.empty()) {
+        continue;
+      }
+      firing_.swap(slot);
+      size_ -= firing_.size();
+      for (const auto &e : firing_) {
+        expired(e.id);
+      }
+      firing_.clear();
+    }
+  }
+
+private:
+  static constexpr std::size_t kBits = 6;
+  static constexpr std::size_t kSlots = std::size_t{1} << kBits;
+  static constexpr std::uint64_t kMask = kSlots - 1;
+  static constexpr std::size_t kLevels = 4;
+  static constexpr std::uint64_t kRange = std::uint64_t{1}
+                                          << (kBits * kLevels);
+
+  struct Entry {
+    std::uint32_t id;
+    std::uint64_t deadline;
+  };
+
+  // Requires deadline >= now_ (== only while cascading, before level 0 of
+  // the current tick runs).
+  void place(const Entry &e) {
+    const std::uint64_t delta = e.deadline - now_;
+    std::size_t level = 0;
+    while (level + 1 < kLevels &&
+           delta >= (std::uint64_t{1} << (kBits * (level + 1)))) {
+      ++level;
+    }
+    slots_[level][(e.deadline >> (kBits * level)) & kMask].push_back(e);
+  }
+
+  void cascade(std::size_t level) {
+    auto &slot = slots_[level][(now_ >> (kBits * level)) & kMask];
+    if (slot.empty()) {
+      return;
+    }
+    cascading_.swap(slot);
+    for (const auto &e : cascading_) {
+      place(e);
+    }
+    cascading_.clear();
+  }
+
+  std::uint64_t now_;
+  std::size_t size_ = 0;
+  std::array<std::array<std::vector<Entry>, kSlots>, kLevels> slots_{};
+  std::vector<Entry> firing_;
+  std::vector<Entry> cascading_;
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "models/net.hpp"
+
+// Compile-time descriptions of the fixed-size wire layouts.
+//
+// A Layout lists, for one record type, which member sits at which byte
+// offset; the width of each field is the size of the member. From that it
+// generates fully unrolled decoders and encoders for either byte order,
+// with no per-field branches or lookups left at runtime. Offsets are
+// checked when the layout is declared: every field must fit, and fields
+// must be listed in order without overlapping.
+//
+// Adding a message type means declaring a struct and its Layout next to
+// the ones below; Parser and the codecs then read it through the same
+// generated code.
+namespace wire_schema {
+
+namespace detail {
+
+template <std::size_t N> struct uint_of;
+template <> struct uint_of<1> { using type = std::uint8_t; };
+template <> struct uint_of<2> { using type = std::uint16_t; };
+template <> struct uint_of<4> { using type = std::uint32_t; };
+template <> struct uint_of<8> { using type = std::uint64_t; };
+
+template <typename M> struct member;
+template <typename R, typename T> struct member<T R::*> {
+  using record = R;
+  using type = T;
+};
+
+template <auto A, auto B> consteval bool same_member() {
+  if constexpr (std::is_same_v<decltype(A), decltype(B)>) {
+    return A == B;
+  } else {
+    return false;
+  }
+}
+
+} // namespace detail
+
+template <typename T>
+concept Scalar = std::is_arithmetic_v<T> &&
+                 (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 ||
+                  sizeof(T) == 8);
+
+// One scalar at `in`/`out` in byte order E. These compile to a plain load
+// or store, plus a bswap when E is not the host order.
+template <std::endian E, Scalar T>
+[[nodiscard]] inline T load(const std::byte *in) noexcept {
+  using U = typename detail::uint_of<sizeof(T)>::type;
+  U raw;
+  std::memcpy(&raw, in, sizeof(raw));
+  if constexpr (sizeof(T) > 1 && E != std::endian::native) {
+    raw = std::byteswap(raw);
+  }
+  return std::bit_cast<T>(raw);
+}
+
+template <Scalar T>
+[[nodiscard]] inline T load(const std::byte *in, std::endian e) noexcept {
+  return e == std::endian::big ? load<std::endian::big, T>(in)
+                               : load<std::endian::little, T>(in);
+}
+
+template <std::endian E, Scalar T>
+inline void store(std::byte *out, T v) noexcept {
+  using U = typename detail::uint_of<sizeof(T)>::type;
+  auto raw = std::bit_cast<U>(v);
+  if constexpr (sizeof(T) > 1 && E != std::endian::native) {
+    raw = std::byteswap(raw);
+  }
+  std::memcpy(out, &raw, sizeof(raw));
+}
+
+// Member `Member` of the record, stored at byte `Offset`.
+template <auto Member, std::size_t Offset> struct Field {
+  using Record = typename detail::member<decltype(Member)>::record;
+  using Type = typename detail::member<decltype(Member)>::type;
+  static_assert(Scalar<Type>, "wire fields must be 1-, 2-, 4- or 8-byte "
+                              "integers or floats");
+
+  static constexpr auto member = Member;
+  static constexpr std::size_t offset = Offset;
+  static constexpr std::size_t width = sizeof(Type);
+
+  template <std::endian E>
+  static void read(const std::byte *in, Record &r) noexcept {
+    r.*Member = load<E, Type>(in + Offset);
+  }
+
+  template <std::endian E>
+  static void write(std::byte *out, const Record &r) noexcept {
+    store<E>(out + Offset, r.*Member);
+  }
+};
+
+// `Size` bytes on the wire holding `Fields` of an `R`. Bytes no field
+// covers are padding: ignored by decode, zeroed by encode.
+template <typename R, std::size_t Size, typename... Fields> struct Layout {
+  using Record = R;
+  static constexpr std::size_t size = Size;
+
+  static_assert((std::is_same_v<typename Fields::Record, R> && ...),
+                "every field must be a member of the layout's record");
+
+private:
+  static consteval bool in_order() {
+    constexpr std::size_t n = sizeof...(Fields);
+    const std::array<std::size_t, n> off{Fields::offset...};
+    const std::array<std::size_t, n> width{Fields::width...};
+    for (std::size_t i = 0; i < n; ++i) {
+      const std::size_t end = i + 1 < n ? off[i + 1] : Size;
+      if (off[i] + width[i] > end) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <auto Member> static consteval std::size_t find() {
+    std::size_t off = Size;
+    ((detail::same_member<Fields::member, Member>() ? (off = Fields::offset)
+                                                    : off),
+     ...);
+    return off;
+  }
+
+public:
+  static_assert(in_order(), "fields must be listed by offset, fit in the "
+                            "layout and not overlap");
+
+  static constexpr bool dense = (std::size_t{0} + ... + Fields::width) == Size;
+
+  // Byte offset of `Member`; only declared for members in the layout.
+  template <auto Member>
+    requires(find<Member>() < Size)
+  static constexpr std::size_t offset = find<Member>();
+
+  // `Size` bytes at `in` (the caller checks the length).
+  template <std::endian E>
+  [[nodiscard]] static R decode(const std::byte *in) noexcept {
+    R r{};
+    (Fields::template read<E>(in, r), ...);
+    return r;
+  }
+
+  template <std::endian E>
+  static void encode(const R &r, std::byte *out) noexcept {
+    if constexpr (!dense) {
+      std::memset(out, 0, Size);
+    }
+    (Fields::template write<E>(out, r), ...);
+  }
+
+  // One field, without decoding the rest.
+  template <auto Member, std::endian E>
+  [[nodiscard]] static auto get(const std::byte *in) noexcept {
+    using T = typename detail::member<decltype(Member)>::type;
+    return load<E, T>(in + offset<Member>);
+  }
+
+  template <auto Member>
+  [[nodiscard]] static auto get(const std::byte *in, std::endian e) noexcept {
+    using T = typename detail::member<decltype(Member)>::type;
+    return load<T>(in + offset<Member>, e);
+  }
+};
+
+} // namespace wire_schema
+
+// Optional header in front of a client payload.
+struct Header {
+  // Bits of `type` a client may set to declare the byte order of `len` and
+  // the payload, instead of leaving it to the parser's guess.
+  static constexpr uint8_t kOrderDeclared = 0x80;
+  static constexpr uint8_t kOrderBig = 0x40;
+
+  uint8_t magic;
+  uint8_t type;
+  uint16_t len; // payload bytes that follow: 21 or 24
+  uint32_t seq;
+};
+
+namespace wire_schema {
+
+using PacketHeader =
+    Layout<Header, 8, Field<&Header::magic, 0>, Field<&Header::type, 1>,
+           Field<&Header::len, 2>, Field<&Header::seq, 4>>;
+
+// Client payloads. Both carry op, id, x, y, color and size; the 24-byte
+// one pads color out to a word before size.
+using Players24 =
+    Layout<Players, 24, Field<&Players::op, 0>, Field<&Players::id, 4>,
+           Field<&Players::x, 8>, Field<&Players::y, 12>,
+           Field<&Players::color, 16>, Field<&Players::size, 20>>;
+
+using Players21 =
+    Layout<Players, 21, Field<&Players::op, 0>, Field<&Players::id, 4>,
+           Field<&Players::x, 8>, Field<&Players::y, 12>,
+           Field<&Players::color, 16>, Field<&Players::size, 17>>;
+
+static_assert(PacketHeader::size == sizeof(Header) && PacketHeader::dense);
+static_assert(Players21::dense && !Players24::dense);
+
+} // namespace wire_schema
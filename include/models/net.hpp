@@ -1,20 +1,95 @@
 #pragma once
 #include <arpa/inet.h>
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
 #include <span>
 #include <type_traits>
 
 struct PacketView {
-  sockaddr_storage peer;
+  const sockaddr_storage *peer;
   socklen_t peer_len;
   std::span<const std::byte> bytes;
 };
 
-struct PeerInfo {
-  sockaddr_storage addr{};
-  socklen_t len{};
+// Receive descriptor handed from a driver to the router. `peer` and `data`
+// point into a driver-owned receive buffer, which stays untouched until the
+// router hands `buf` back; nothing is copied between the kernel and the
+// parser.
+struct RxPacket {
+  enum class Kind : std::uint8_t { Packet, Tick, Housekeeping };
+  static constexpr std::uint16_t kNoBuffer = 0xffff;
+
+  const sockaddr_storage *peer = nullptr;
+  const std::byte *data = nullptr;
+  std::uint32_t len = 0;
+  socklen_t peer_len = 0;
+  std::uint16_t buf = kNoBuffer;
+  Kind kind = Kind::Packet;
+  std::uint64_t rx_ns = 0; // metrics::now_ns() when the ring reaped it
+};
+
+// Hands a receive buffer back from the router: `refs` packets lent from
+// `buf` (every segment of a GRO read) are done with, in one queue entry.
+struct RxRelease {
+  std::uint16_t buf = RxPacket::kNoBuffer;
+  std::uint16_t refs = 0;
 };
 
+// Compact UDP peer address: 24 bytes for both IPv4 and IPv6 instead of a
+// 128-byte sockaddr_storage. IPv4 addresses use the first four bytes of
+// `addr`; port and address stay in network byte order.
+struct Endpoint {
+  std::array<std::uint8_t, 16> addr{};
+  std::uint32_t scope_id = 0; // IPv6 only
+  std::uint16_t port = 0;
+  std::uint16_t family = AF_UNSPEC;
+
+  static Endpoint from_sockaddr(const sockaddr_storage &ss,
+                                socklen_t len) noexcept {
+    Endpoint ep{};
+    if (ss.ss_family == AF_INET && len >= sizeof(sockaddr_in)) {
+      const auto *sin = reinterpret_cast<const sockaddr_in *>(&ss);
+      ep.family = AF_INET;
+      ep.port = sin->sin_port;
+      std::memcpy(ep.addr.data(), &sin->sin_addr, sizeof(sin->sin_addr));
+    } else if (ss.ss_family == AF_INET6 && len >= sizeof(sockaddr_in6)) {
+      const auto *sin6 = reinterpret_cast<const sockaddr_in6 *>(&ss);
+      ep.family = AF_INET6;
+      ep.port = sin6->sin6_port;
+      ep.scope_id = sin6->sin6_scope_id;
+      std::memcpy(ep.addr.data(), &sin6->sin6_addr, sizeof(sin6->sin6_addr));
+    }
+    return ep;
+  }
+
+  // Returns the sockaddr length, or 0 for an unset endpoint.
+  socklen_t to_sockaddr(sockaddr_storage &ss) const noexcept {
+    std::memset(&ss, 0, sizeof(ss));
+    if (family == AF_INET) {
+      auto *sin = reinterpret_cast<sockaddr_in *>(&ss);
+      sin->sin_family = AF_INET;
+      sin->sin_port = port;
+      std::memcpy(&sin->sin_addr, addr.data(), sizeof(sin->sin_addr));
+      return sizeof(sockaddr_in);
+    }
+    if (family == AF_INET6) {
+      auto *sin6 = reinterpret_cast<sockaddr_in6 *>(&ss);
+      sin6->sin6_family = AF_INET6;
+      sin6->sin6_port = port;
+      sin6->sin6_scope_id = scope_id;
+      std::memcpy(&sin6->sin6_addr, addr.data(), sizeof(sin6->sin6_addr));
+      return sizeof(sockaddr_in6);
+    }
+    return 0;
+  }
+
+  friend bool operator==(const Endpoint &, const Endpoint &) = default;
+};
+
+static_assert(sizeof(Endpoint) == 24, "Endpoint should stay compact");
+
 struct Players {
   // 0 register, 1 player, 2 update
   std::uint32_t op;
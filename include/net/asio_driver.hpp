@@ -1,8 +1,10 @@
 #pragma once
 
 #include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 
 #include <boost/asio.hpp>
 
@@ -11,17 +13,21 @@
 
 class AsioDriver : public INetOut {
 public:
-  explicit AsioDriver(std::uint16_t port);
-  ~AsioDriver() override = default;
+  explicit AsioDriver(std::uint16_t port, const RouterConfig &router_cfg = {});
+  ~AsioDriver() override;
 
   void start();
-  void send_to(const sockaddr_storage &dst, socklen_t dst_len, const void *data,
+  void send_to(const Endpoint &dst, const void *data,
                size_t len) noexcept override;
+  void send_to_all(std::span<const Endpoint> dsts, const void *data,
+                   size_t len) noexcept override;
 
 private:
   void start_receive();
-  static boost::asio::ip::udp::endpoint to_endpoint(const sockaddr_storage &dst,
-                                                    socklen_t dst_len) noexcept;
+  void start_tick();
+  void start_housekeeping();
+  static boost::asio::ip::udp::endpoint
+  to_endpoint(const Endpoint &dst) noexcept;
 
   boost::asio::io_context io_;
   boost::asio::ip::udp::socket socket_;
@@ -29,5 +35,10 @@ private:
   std::array<std::byte, 2048> buf_{};
   Router router_;
 
+  boost::asio::steady_timer tick_timer_;
+  std::chrono::nanoseconds tick_period_{0};
+  boost::asio::steady_timer housekeeping_timer_;
+  std::chrono::milliseconds housekeeping_period_{0};
+
   boost::asio::signal_set signals_;
 };
@@ -1,12 +1,21 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <netinet/in.h>
 #include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "models/net.hpp"
 
 struct UdpState {
-  static constexpr size_t kBufSize = 2048;
-  alignas(16) char buf[kBufSize];
+  // Receive buffer lent to this slot: recvmsg writes the peer address at
+  // its start and the payload right after, so both can be handed to the
+  // router without copying.
+  uint16_t buf_id = 0;
+  bool armed = false;
 
   sockaddr_storage peer{};
   socklen_t peer_len = sizeof(peer);
@@ -15,6 +24,8 @@ struct UdpState {
 
   iovec iov{};
   msghdr msg{};
+  // Receives the UDP_GRO segment size when GRO is on.
+  alignas(cmsghdr) std::array<unsigned char, CMSG_SPACE(sizeof(int))> control{};
 
   iovec siov{};
   msghdr smsg{};
@@ -22,10 +33,38 @@ struct UdpState {
   std::string out;
 };
 
-struct SendState {
+// Immutable payload shared by every send of one fan-out. The router thread
+// fills it and sets `refs` to the number of queued sends; the ring thread
+// drops one reference per send completion. A zero count means free.
+struct SharedPayload {
   static constexpr size_t kMax = 2048;
 
+  std::atomic<uint32_t> refs{0};
+  size_t len = 0;
+  alignas(16) std::array<std::byte, kMax> buf{};
+};
+
+// One UDP_SEGMENT (GSO) send: payloads for a single destination that the
+// kernel gathers from `iov` and splits back into datagrams of the first
+// payload's size. All but the last payload have that size.
+struct GsoBatch {
+  // UDP_MAX_SEGMENTS since UDP GSO was added (newer kernels allow 128).
+  static constexpr size_t kMaxSegments = 64;
+
+  uint32_t count = 0;
+  std::array<uint32_t, kMaxSegments> payloads{};
+  std::array<iovec, kMaxSegments> iov{};
+  alignas(cmsghdr) std::array<unsigned char,
+                              CMSG_SPACE(sizeof(uint16_t))> control{};
+};
+
+struct SendState {
+  static constexpr uint32_t kNoGso = UINT32_MAX;
+
   bool busy = false;
+  // Zero-copy send: the slot and payload stay pinned until the kernel posts
+  // the IORING_CQE_F_NOTIF completion, after the send result itself.
+  bool zc = false;
 
   sockaddr_storage dst{};
   socklen_t dst_len = 0;
@@ -33,6 +72,15 @@ struct SendState {
   iovec iov{};
   msghdr msg{};
 
-  alignas(16) std::array<std::byte, kMax> buf{};
-  size_t len = 0;
+  uint32_t payload = 0;
+  // GsoBatch index when this slot carries a UDP_SEGMENT send; its payloads
+  // replace `payload` and `iov`.
+  uint32_t gso = kNoGso;
+};
+
+// Send request handed from the router thread to the ring-owning thread.
+struct SendCmd {
+  Endpoint dst{};
+  uint32_t payload = 0;
+  uint64_t queued_ns = 0; // metrics::now_ns() when the router queued it
 };
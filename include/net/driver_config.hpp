@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+struct DriverConfig {
+  // Multishot recvmsg over a provided buffer ring. Falls back to the
+  // two-slot recvmsg path when the kernel lacks buffer rings or multishot.
+  bool multishot_recv = true;
+  // Number of provided receive buffers (rounded up to a power of two).
+  uint32_t recv_buffers = 1024;
+  // Bytes per provided buffer, including the io_uring_recvmsg_out header
+  // and peer address that the kernel writes in front of the payload.
+  uint32_t recv_buffer_size = 2048;
+  // UDP GRO (UDP_GRO on the socket, set by Server::init): the kernel may
+  // hand over up to 64 datagrams of one flow in a single buffer, which the
+  // driver splits back into packets by the segment size it reports. Buffers
+  // are grown to hold 64 of the largest packet Parser accepts; a larger
+  // coalesced read is truncated to its whole segments.
+  bool gro_recv = false;
+
+  // In-flight sendmsg slots. Fan-out sends share one payload, so a slot is
+  // only a msghdr and a destination.
+  uint32_t send_slots = 4096;
+  // Shared payload buffers (one per broadcast in flight).
+  uint32_t send_payloads = 1024;
+  // Router -> ring thread send commands.
+  uint32_t outbound_queue = 8192;
+
+  // Zero-copy sends (IORING_OP_SEND_ZC) from the registered payload pool
+  // for payloads of at least `zerocopy_threshold` bytes. Page pinning and
+  // the extra notification CQE cost more than a memcpy of small payloads;
+  // bench_zc_crossover measures where the crossover falls on a given box.
+  bool zerocopy_send = false;
+  uint32_t zerocopy_threshold = 1024;
+
+  // UDP GSO (UDP_SEGMENT): sends queued for the same destination within
+  // one loop turn go out as one sendmsg that the kernel splits back into
+  // datagrams, up to `gso_max_segments` (at most 64) at a time. Only runs
+  // of equal-size payloads coalesce; each GSO send in flight holds one of
+  // `gso_slots`. Off when the kernel lacks UDP_SEGMENT, and switched off
+  // at runtime if the device rejects it.
+  bool gso_send = true;
+  uint32_t gso_max_segments = 64;
+  uint32_t gso_slots = 256;
+
+  // IORING_SETUP_SQPOLL: a kernel thread polls the submission queue, so
+  // submitting needs no syscall while it is awake. It sleeps after
+  // `sqpoll_idle_ms` without work. If `sqpoll_cpu` >= 0, shard i pins its
+  // poller to CPU `sqpoll_cpu + i` (modulo the CPU count).
+  bool sqpoll = false;
+  uint32_t sqpoll_idle_ms = 2000;
+  int sqpoll_cpu = -1;
+  // Register the UDP socket and wake eventfd with io_uring_register_files
+  // and address them by index (IOSQE_FIXED_FILE). Always on with sqpoll.
+  bool fixed_files = false;
+
+  // Token bucket per source endpoint, checked as each datagram completes
+  // and before it is handed to the router: `endpoint_rate` packets/s with
+  // bursts of `endpoint_burst` (0 rate disables). The buckets live in a
+  // fixed table of `rate_limit_slots`, so a flood of spoofed sources
+  // cannot grow it. SO_REUSEPORT keeps a source on one shard, so the
+  // limit is per endpoint server-wide.
+  uint32_t endpoint_rate = 500;
+  uint32_t endpoint_burst = 1000;
+  uint32_t rate_limit_slots = 8192;
+};
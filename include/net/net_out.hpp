@@ -1,9 +1,23 @@
 #pragma once
 #include <cstdint>
+#include <span>
 #include <sys/socket.h>
 
+#include "models/net.hpp"
+
 struct INetOut {
-  virtual void send_to(const sockaddr_storage &dst, socklen_t dst_len,
-                       const void *data, size_t len) = 0;
+  virtual void send_to(const Endpoint &dst, const void *data,
+                       size_t len) = 0;
+  // Sends one payload to every destination. Transports override this to
+  // stage the payload once and share it across all the sends.
+  virtual void send_to_all(std::span<const Endpoint> dsts, const void *data,
+                           size_t len) {
+    for (const auto &dst : dsts) {
+      send_to(dst, data, len);
+    }
+  }
+  // Called after a burst of send_to calls so the transport can hand them to
+  // the kernel as one batch. Transports that send inline ignore it.
+  virtual void flush() noexcept {}
   virtual ~INetOut() = default;
 };
@@ -1,15 +1,27 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
+#include <utility>
+
+#include "core/router_config.hpp"
+#include "net/driver_config.hpp"
 
 struct ServerConfig {
   uint16_t port;
   uint16_t threads;
+  DriverConfig driver{};
+  RouterConfig router{};
+  // POSIX shm name of the metrics segment read by udp_stats (empty keeps
+  // metrics in-process only).
+  std::string stats_shm = "/udp-uring-stats";
 };
 
 class Server {
 public:
-  explicit Server(ServerConfig cfg) : port_(cfg.port), threads_(cfg.threads) {}
+  explicit Server(ServerConfig cfg)
+      : port_(cfg.port), threads_(cfg.threads), driver_(cfg.driver),
+        router_(cfg.router), stats_shm_(std::move(cfg.stats_shm)) {}
   int init();
   //~Server();
 
@@ -24,4 +36,7 @@ public:
 private:
   uint16_t port_;
   uint16_t threads_;
+  DriverConfig driver_;
+  RouterConfig router_;
+  std::string stats_shm_;
 };
@@ -2,35 +2,224 @@
 
 #include <liburing.h>
 
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "core/rate_limit.hpp"
 #include "core/router.hpp"
+#include "core/spsc.hpp"
 #include "net/connection.hpp"
+#include "net/driver_config.hpp"
 
 class UringDriver : public INetOut {
 public:
-  UringDriver(int fd);
+  // Completions reaped per event-loop turn.
+  struct LoopStats {
+    uint64_t turns = 0;
+    uint64_t completions = 0;
+    uint32_t max_batch = 0;
+    // batch_hist[0] counts empty turns, batch_hist[k] turns that reaped
+    // [2^(k-1), 2^k) completions; the last bucket is open-ended.
+    std::array<uint64_t, 12> batch_hist{};
+
+    void record(uint32_t cqes) noexcept;
+  };
+
+  explicit UringDriver(int fd, const DriverConfig &cfg = {},
+              const RouterConfig &router_cfg = {}, ShardBus *bus = nullptr,
+              size_t shard = 0);
   ~UringDriver() noexcept override;
 
   bool submit_recv(uint32_t slot) noexcept;
+  bool submit_recv_multishot() noexcept;
   bool submit_send(uint32_t slot) noexcept;
   bool submit_close(int fd) noexcept;
-  void send_to(const sockaddr_storage &dst, socklen_t dst_len, const void *data,
+  bool submit_wake_read() noexcept;
+  void init_timer(uint32_t which, uint64_t period_ns) noexcept;
+  bool submit_timer(uint32_t which) noexcept;
+  // Called from the router thread: queues the send for the ring owner.
+  void send_to(const Endpoint &dst, const void *data,
                size_t len) noexcept override;
+  void send_to_all(std::span<const Endpoint> dsts, const void *data,
+                   size_t len) noexcept override;
+  void flush() noexcept override;
 
   void recv(uint32_t slot, int res) noexcept;
-  void send(uint32_t slot, int res) noexcept;
+  void recv_multishot(int res, uint32_t flags) noexcept;
+  void send(uint32_t slot, int res, uint32_t flags) noexcept;
+  void on_wake(int res) noexcept;
+  void on_timer(uint32_t which, int res) noexcept;
+  void drain_outbound() noexcept;
 
   [[nodiscard]] SendState *acquire_send_slot(uint32_t &idx_out) noexcept;
-  void on_send_complete(uint32_t send_idx, int res) noexcept;
+  void on_send_complete(uint32_t send_idx, int res, uint32_t flags) noexcept;
+
+  // Router thread: claims a free shared payload and copies `data` into it.
+  [[nodiscard]] SharedPayload *acquire_payload(const void *data, size_t len,
+                                               uint32_t &idx_out) noexcept;
+  void release_payload(uint32_t idx, uint32_t refs = 1) noexcept;
+
+  void handle_cqe(const io_uring_cqe *cqe) noexcept;
+  [[nodiscard]] const LoopStats &loop_stats() const noexcept {
+    return loop_stats_;
+  }
 
   void start() noexcept;
+  // Thread-safe: asks the ring thread to leave start().
+  void stop() noexcept;
 
 private:
+  void init_rx_pool() noexcept;
+  bool setup_buf_ring() noexcept;
+  void free_buf_ring() noexcept;
+  void recycle_buffer(uint16_t bid) noexcept;
+  [[nodiscard]] std::byte *rx_buffer(uint16_t bid) const noexcept {
+    return buf_pool_.get() + size_t(bid) * buf_size_;
+  }
+  // Hands a received packet to the router; the buffer comes back through
+  // reclaim_rx() once the router is done with it. Packets are batched and
+  // published by flush_rx() once per loop turn.
+  void lend_rx(const RxPacket &pkt) noexcept;
+  // Lends each datagram of a received buffer: one, or with GRO every
+  // `segment` bytes. Takes the buffer either way; it is reused once no
+  // lent datagram refers to it, at once if none was admitted.
+  void lend_datagrams(const sockaddr_storage *peer, socklen_t peer_len,
+                      const std::byte *data, uint32_t len, uint32_t segment,
+                      uint16_t bid) noexcept;
+  void flush_rx() noexcept;
+  // Per-endpoint ingress limit; false means drop the datagram.
+  bool admit(const sockaddr_storage *peer, socklen_t len) noexcept;
+  // Drops `refs` router references to `bid`, reusing it at zero.
+  void release_rx(uint16_t bid, uint16_t refs = 1) noexcept;
+  void reclaim_rx() noexcept;
+  void fallback_to_slots() noexcept;
+  bool register_payloads() noexcept;
+  void init_ring();
+  void register_files() noexcept;
+  // Points `sqe` at the UDP socket, by registered index when available.
+  void use_udp_file(io_uring_sqe *sqe) const noexcept;
+  // Prepares `cmd` as its own sendmsg (or zero-copy send) on send slot
+  // `sidx`. Without an SQE the slot and payload are released and the send
+  // is dropped.
+  bool submit_cmd(uint32_t sidx, const SendCmd &cmd, uint64_t now) noexcept;
+
+  // UDP GSO egress (DriverConfig::gso_send).
+  struct DstGroup {
+    uint16_t first;
+    uint16_t last;
+    uint16_t slot; // in group_index_
+  };
+  bool probe_gso() const noexcept;
+  bool probe_gro() const noexcept;
+  void drain_outbound_gso() noexcept;
+  void group_staged(size_t n) noexcept;
+  bool submit_group(uint16_t first, uint64_t now) noexcept;
+  bool submit_gso(uint32_t sidx, uint16_t first, uint32_t count,
+                  uint64_t now) noexcept;
+  void drop_staged(uint16_t first) noexcept;
+  [[nodiscard]] bool gso_eligible(size_t len) const noexcept {
+    return len <= kGsoMaxSegment &&
+           !(zerocopy_ && len >= cfg_.zerocopy_threshold);
+  }
+
   io_uring ring_{};
   int fd_{-1};
+  bool sqpoll_ = false;
+  bool fixed_files_ = false;
+  static constexpr int kUdpFileIdx = 0;
+  static constexpr int kWakeFileIdx = 1;
+  DriverConfig cfg_;
   static constexpr int kUdpSlots = 2;
-  static constexpr uint32_t kSendSlots = 256;
-  SendState send_[kSendSlots];
-  uint32_t send_rr_ = 0;
+  static constexpr int kRecvBufGroup = 0;
+  std::unique_ptr<SendState[]> send_;
+  std::vector<uint32_t> send_free_;
+  uint32_t send_count_ = 0;
+
+  std::unique_ptr<SharedPayload[]> payloads_;
+  uint32_t payload_count_ = 0;
+  uint32_t payload_rr_ = 0; // router thread only
+  bool zerocopy_ = false;
   UdpState udp_[kUdpSlots];
+
+  // With GSO, drain_outbound() stages up to kSendStage commands, chains
+  // them per destination (group_index_ is an open-addressing table over
+  // groups_, staged_next_ links a group's commands in queue order) and
+  // coalesces each chain into UDP_SEGMENT sends.
+  bool gso_ = false;
+  uint32_t gso_max_ = 0;
+  std::unique_ptr<GsoBatch[]> gso_batches_;
+  std::vector<uint32_t> gso_free_;
+  static constexpr size_t kSendStage = 1024;
+  static constexpr uint16_t kNoCmd = 0xffff;
+  // Largest segment that still fits a 1500-byte MTU over IPv6; the kernel
+  // refuses GSO segments above the path MTU instead of fragmenting them.
+  static constexpr size_t kGsoMaxSegment = 1452;
+  // Largest UDP payload over IPv4, and so the most one GSO send may carry.
+  static constexpr size_t kGsoMaxBytes = 65507;
+  std::array<SendCmd, kSendStage> staged_{};
+  std::array<uint16_t, kSendStage> staged_next_{};
+  std::vector<DstGroup> groups_;
+  static constexpr size_t kGroupSlots = 2 * kSendStage;
+  std::array<uint16_t, kGroupSlots> group_index_{}; // group + 1; 0 = free
+
+  // UDP GRO receive (DriverConfig::gro_recv): a buffer may hold up to
+  // kGroMaxSegments datagrams, so it needs room for that many of the
+  // largest packet Parser accepts.
+  bool gro_ = false;
+  static constexpr size_t kGroMaxSegments = 64; // UDP_GRO_CNT_MAX
+  static constexpr size_t kGroMinPayload =
+      kGroMaxSegments * (sizeof(Header) + wire_schema::Players24::size);
+
+  // Receive buffer pool. With multishot recvmsg the buffers form the
+  // provided buffer ring; on the slot path they are lent to the slots from
+  // rx_free_. Either way a buffer holding a packet belongs to the router
+  // until it is handed back.
+  bool multishot_ = false;
+  bool recv_starved_ = false; // multishot ended on -ENOBUFS, not re-armed
+  uint32_t ring_bufs_ = 0;     // buffers currently in the provided ring
+  io_uring_buf_ring *buf_ring_ = nullptr;
+  std::unique_ptr<std::byte[]> buf_pool_;
+  uint32_t buf_count_ = 0;
+  uint32_t buf_size_ = 0;
+  std::vector<uint16_t> rx_refs_; // outstanding router references
+  std::vector<uint16_t> rx_free_; // slot path only
+  static constexpr size_t kRxBatch = 64;
+  static_assert(kGroMaxSegments <= kRxBatch,
+                "a GRO read must fit one router publish");
+  std::array<RxPacket, kRxBatch> rx_batch_{};
+  size_t rx_batched_ = 0;
+  msghdr mshot_msg_{};
+
+  // Outbound pipeline: router thread produces, ring thread drains and
+  // submits. The eventfd wakes the ring thread out of io_uring_wait_cqe.
+  SPSC<SendCmd> outq_;
+  SendCmd out_cmd_{};
+  int wake_fd_{-1};
+  uint64_t wake_buf_ = 0;
+  std::atomic<bool> wake_pending_{false};
+  std::atomic<bool> stop_{false};
+
+  // Periodic router markers, each a timeout SQE re-armed on every expiry:
+  // the tick (RouterConfig::tick_hz) and idle-peer housekeeping
+  // (RouterConfig::housekeeping_ms).
+  static constexpr uint32_t kTickTimer = 0;
+  static constexpr uint32_t kHousekeepingTimer = 1;
+  struct RingTimer {
+    __kernel_timespec ts{};
+    bool enabled = false;
+    bool armed = false;
+  };
+  std::array<RingTimer, 2> timers_{};
+
+  LoopStats loop_stats_{};
+  size_t shard_ = 0;
+
+  RateLimiter<Endpoint, EndpointHash> ingress_limit_;
+  uint64_t rx_now_ns_ = 0; // sampled once per loop turn
+
   Router router_;
 };
@@ -2,16 +2,18 @@
 
 #include <csignal>
 #include <cstring>
-#include <iostream>
 #include <span>
 #include <vector>
 
 #include <arpa/inet.h>
 
+#include "core/metrics.hpp"
+
 using boost::asio::ip::udp;
 
-AsioDriver::AsioDriver(std::uint16_t port)
-    : io_(), socket_(io_), remote_(), router_(*this)
+AsioDriver::AsioDriver(std::uint16_t port, const RouterConfig &router_cfg)
+    : io_(), socket_(io_), remote_(), router_(*this, router_cfg),
+      tick_timer_(io_), housekeeping_timer_(io_)
 #if !defined(_WIN32)
       ,
       signals_(io_, SIGINT, SIGTERM)
@@ -22,64 +24,103 @@ AsioDriver::AsioDriver(std::uint16_t port)
   socket_.set_option(boost::asio::socket_base::reuse_address(true));
   socket_.bind(ep);
 
+  if (router_cfg.tick_hz > 0) {
+    tick_period_ = std::chrono::nanoseconds(1'000'000'000ll / router_cfg.tick_hz);
+  }
+  if (router_.evicting()) {
+    housekeeping_period_ = std::chrono::milliseconds(router_cfg.housekeeping_ms);
+  }
+
 #if !defined(_WIN32)
   signals_.async_wait(
       [this](const boost::system::error_code &, int) { io_.stop(); });
 #endif
+  router_.start();
+}
+
+AsioDriver::~AsioDriver() {
+  // Joins the worker before the socket it sends on goes away.
+  router_.stop();
 }
 
 void AsioDriver::start() {
-  UDP_LOGLN("Starting Boost ASIO service...");
+  metrics::attach("asio");
+  UDP_INFO("Starting Boost ASIO service...");
   start_receive();
+  if (tick_period_.count() > 0) {
+    start_tick();
+  }
+  if (housekeeping_period_.count() > 0) {
+    start_housekeeping();
+  }
   io_.run();
 }
 
+void AsioDriver::start_tick() {
+  tick_timer_.expires_after(tick_period_);
+  tick_timer_.async_wait([this](const boost::system::error_code &ec) {
+    if (ec == boost::asio::error::operation_aborted)
+      return;
+    router_.on_tick();
+    start_tick();
+  });
+}
+
+void AsioDriver::start_housekeeping() {
+  housekeeping_timer_.expires_after(housekeeping_period_);
+  housekeeping_timer_.async_wait([this](const boost::system::error_code &ec) {
+    if (ec == boost::asio::error::operation_aborted)
+      return;
+    router_.on_housekeeping();
+    start_housekeeping();
+  });
+}
+
 void AsioDriver::start_receive() {
   socket_.async_receive_from(
       boost::asio::buffer(buf_), remote_,
       [this](const boost::system::error_code &ec, std::size_t bytes) {
         if (!ec && bytes > 0) {
+          metrics::count(metrics::Counter::RxPackets);
+          metrics::count(metrics::Counter::RxBytes, bytes);
           sockaddr_storage ss{};
           std::memcpy(&ss, remote_.data(), remote_.size());
           socklen_t len = static_cast<socklen_t>(remote_.size());
           std::span<const std::byte> span(buf_.data(), bytes);
-          PacketView pkt{ss, len, span};
+          PacketView pkt{&ss, len, span};
           router_.on_packet(pkt);
         } else if (ec != boost::asio::error::operation_aborted) {
-          UDP_LOGLN("asio recv error: " << ec.message());
+          metrics::count(metrics::Counter::RecvErrors);
+          UDP_ERROR_EVERY(1000, "asio recv error: {}", ec.message());
         }
         start_receive();
       });
 }
 
 boost::asio::ip::udp::endpoint
-AsioDriver::to_endpoint(const sockaddr_storage &dst,
-                        socklen_t dst_len) noexcept {
-  (void)dst_len;
-
-  if (dst.ss_family == AF_INET) {
-    auto *sin = reinterpret_cast<const sockaddr_in *>(&dst);
-    auto addr = boost::asio::ip::address_v4(ntohl(sin->sin_addr.s_addr));
-    return udp::endpoint(addr, ntohs(sin->sin_port));
+AsioDriver::to_endpoint(const Endpoint &dst) noexcept {
+  if (dst.family == AF_INET) {
+    boost::asio::ip::address_v4::bytes_type bytes{};
+    std::memcpy(bytes.data(), dst.addr.data(), bytes.size());
+    return udp::endpoint(boost::asio::ip::address_v4(bytes), ntohs(dst.port));
   }
 
-  if (dst.ss_family == AF_INET6) {
-    auto *sin6 = reinterpret_cast<const sockaddr_in6 *>(&dst);
+  if (dst.family == AF_INET6) {
     boost::asio::ip::address_v6::bytes_type bytes{};
-    std::memcpy(bytes.data(), &sin6->sin6_addr, bytes.size());
-    auto addr = boost::asio::ip::address_v6(bytes, sin6->sin6_scope_id);
-    return udp::endpoint(addr, ntohs(sin6->sin6_port));
+    std::memcpy(bytes.data(), dst.addr.data(), bytes.size());
+    auto addr = boost::asio::ip::address_v6(bytes, dst.scope_id);
+    return udp::endpoint(addr, ntohs(dst.port));
   }
 
   return udp::endpoint();
 }
 
-void AsioDriver::send_to(const sockaddr_storage &dst, socklen_t dst_len,
-                         const void *data, size_t len) noexcept {
+void AsioDriver::send_to(const Endpoint &dst, const void *data,
+                         size_t len) noexcept {
   if (len == 0)
     return;
 
-  udp::endpoint ep = to_endpoint(dst, dst_len);
+  udp::endpoint ep = to_endpoint(dst);
   if (ep.address().is_unspecified() || ep.port() == 0)
     return;
 
@@ -88,9 +129,43 @@ void AsioDriver::send_to(const sockaddr_storage &dst, socklen_t dst_len,
 
   socket_.async_send_to(
       boost::asio::buffer(*payload), ep,
-      [payload](const boost::system::error_code &ec, std::size_t) {
+      [payload](const boost::system::error_code &ec, std::size_t n) {
         if (ec) {
-          UDP_LOGLN("asio send error: " << ec.message());
+          metrics::count(metrics::Counter::SendErrors);
+          UDP_ERROR_EVERY(1000, "asio send error: {}", ec.message());
+        } else {
+          metrics::count(metrics::Counter::TxPackets);
+          metrics::count(metrics::Counter::TxBytes, n);
         }
       });
 }
+
+void AsioDriver::send_to_all(std::span<const Endpoint> dsts, const void *data,
+                             size_t len) noexcept {
+  if (len == 0 || dsts.empty())
+    return;
+
+  // One immutable copy shared by every pending send; the last completion
+  // handler to run releases it.
+  auto payload = std::make_shared<const std::vector<std::byte>>(
+      static_cast<const std::byte *>(data),
+      static_cast<const std::byte *>(data) + len);
+
+  for (const auto &dst : dsts) {
+    udp::endpoint ep = to_endpoint(dst);
+    if (ep.address().is_unspecified() || ep.port() == 0)
+      continue;
+
+    socket_.async_send_to(
+        boost::asio::buffer(*payload), ep,
+        [payload](const boost::system::error_code &ec, std::size_t n) {
+          if (ec) {
+            metrics::count(metrics::Counter::SendErrors);
+            UDP_ERROR_EVERY(1000, "asio send error: {}", ec.message());
+          } else {
+            metrics::count(metrics::Counter::TxPackets);
+            metrics::count(metrics::Counter::TxBytes, n);
+          }
+        });
+  }
+}
@@ -1,16 +1,29 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstdint>
-#include <iostream>
+#include <cstring>
 
 #include "core/log.hpp"
+#include "core/metrics.hpp"
 #include "net/server.hpp"
 
 #ifdef __linux__
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "core/cpu_pin.hpp"
+#include "core/shard_bus.hpp"
 #include "net/uring_driver.hpp"
 #else
 #include "net/asio_driver.hpp"
@@ -36,6 +49,14 @@ int Server::init() {
     return -1;
   }
 
+#ifdef __linux__
+  // Without GRO support the driver simply receives one datagram per read.
+  if (driver_.gro_recv &&
+      ::setsockopt(fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+    UDP_WARN("setsockopt(UDP_GRO): {}", strerror(errno));
+  }
+#endif
+
   sockaddr_in addr{
       .sin_family = AF_INET,
       .sin_port = htons(port_),
@@ -52,13 +73,76 @@ int Server::init() {
 }
 
 void Server::start() {
-  int fd = init();
-  UDP_LOGLN("Listening on 0.0.0.0:" << port_ << " (Ctrl+C to stop)");
+  // Before any thread exists, so every shard and router thread claims its
+  // metrics slot in the shared segment.
+  if (!stats_shm_.empty() && metrics::open(stats_shm_.c_str())) {
+    UDP_INFO("stats: shared memory {}", stats_shm_);
+  }
+
 #ifdef __linux__
-  UringDriver driver(fd);
-  driver.start();
+  const size_t shards = threads_ > 0 ? threads_ : 1;
+
+  // Block the stop signals before any thread exists so every shard and
+  // router thread inherits the mask; this thread collects them instead.
+  sigset_t stop_set;
+  sigemptyset(&stop_set);
+  sigaddset(&stop_set, SIGINT);
+  sigaddset(&stop_set, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_set, nullptr);
+
+  // Each shard owns a SO_REUSEPORT socket, a ring and a router. The kernel
+  // hashes every client onto one socket, so a peer only ever registers
+  // with one shard; updates are forwarded across shards over the bus.
+  ShardBus bus(shards);
+  std::vector<std::unique_ptr<UringDriver>> drivers;
+  drivers.reserve(shards);
+  for (size_t i = 0; i < shards; ++i) {
+    int fd = init();
+    if (fd < 0) {
+      UDP_ERROR("shard {}: socket setup failed", i);
+      break;
+    }
+    drivers.push_back(std::make_unique<UringDriver>(fd, driver_, router_, &bus, i));
+  }
+  if (drivers.empty()) {
+    return;
+  }
+
+  UDP_INFO("Listening on 0.0.0.0:{} with {} shard(s) (Ctrl+C to stop)", port_,
+           drivers.size());
+
+  const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+  std::atomic<size_t> live{drivers.size()};
+  std::vector<std::thread> workers;
+  workers.reserve(drivers.size());
+  for (size_t i = 0; i < drivers.size(); ++i) {
+    workers.emplace_back([&, i] {
+      try {
+        pin_this_thread_to_cpu(static_cast<int>(i % cpus));
+      } catch (const std::exception &e) {
+        UDP_ERROR("shard {}: {}", i, e.what());
+      }
+      drivers[i]->start();
+      live.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  const timespec poll_interval{.tv_sec = 0, .tv_nsec = 200'000'000};
+  while (live.load(std::memory_order_acquire) == drivers.size()) {
+    if (sigtimedwait(&stop_set, nullptr, &poll_interval) > 0) {
+      break;
+    }
+  }
+
+  for (auto &d : drivers) {
+    d->stop();
+  }
+  for (auto &t : workers) {
+    t.join();
+  }
 #else
-  AsioDriver driver(port_);
+  UDP_INFO("Listening on 0.0.0.0:{} (Ctrl+C to stop)", port_);
+  AsioDriver driver(port_, router_);
   driver.start();
 #endif
 }
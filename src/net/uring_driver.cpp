@@ -1,11 +1,20 @@
 #include "net/uring_driver.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cerrno>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
-#include <signal.h>
+#include <string>
+#include <thread>
+#include <netinet/udp.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include "core/helpers.h"
+#include "core/metrics.hpp"
 #include "models/net.hpp"
 
 enum class OP { REGISTER, UPDATE, BROADCAST, DEREGISTER };
@@ -47,49 +56,395 @@ static void dump_hex(const char *p, size_t n) {
 static constexpr unsigned kQueueDepth = 1024;
 static constexpr size_t kAcceptPipeline = 256;
 
-static volatile sig_atomic_t g_stop = 0;
-static void on_sigint(int) { g_stop = 1; }
+static uint32_t rx_pool_size(const DriverConfig &cfg) {
+  return std::bit_ceil(std::clamp<uint32_t>(cfg.recv_buffers, 2, 32768));
+}
 
-UringDriver::UringDriver(int fd) : fd_(fd), router_(*this) {
-  signal(SIGINT, on_sigint);
+// Every datagram the router sends goes through a SharedPayload, so a batch
+// larger than one would be refused by acquire_payload() on every tick.
+static RouterConfig router_config(const RouterConfig &cfg) {
+  RouterConfig out = cfg;
+  if (out.batch_mtu > SharedPayload::kMax) {
+    UDP_WARN("batch_mtu {} exceeds the {}-byte send payload, clamping",
+             out.batch_mtu, SharedPayload::kMax);
+    out.batch_mtu = SharedPayload::kMax;
+  }
+  return out;
+}
+
+// Segment size of a UDP_GRO-coalesced read, or 0 for a single datagram.
+static uint32_t gro_segment(const cmsghdr *cm) noexcept {
+  if (cm->cmsg_level != SOL_UDP || cm->cmsg_type != UDP_GRO)
+    return 0;
+  int size = 0;
+  std::memcpy(&size, CMSG_DATA(cm), sizeof(size));
+  return size > 0 ? static_cast<uint32_t>(size) : 0;
+}
 
+UringDriver::UringDriver(int fd, const DriverConfig &cfg,
+                         const RouterConfig &router_cfg, ShardBus *bus,
+                         size_t shard)
+    : fd_(fd), cfg_(cfg), outq_(cfg.outbound_queue),
+      shard_(shard),
+      ingress_limit_(cfg.rate_limit_slots, cfg.endpoint_rate,
+                     cfg.endpoint_burst),
+      router_(*this, router_config(router_cfg), bus, shard,
+              rx_pool_size(cfg)) {
   if (fd_ < 0)
     throw ::std::runtime_error("failed to create listen socket");
 
-  if (io_uring_queue_init(kQueueDepth, &ring_, 0) < 0) {
+  init_ring();
+
+  wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0) {
+    io_uring_queue_exit(&ring_);
     ::close(fd_);
-    throw ::std::runtime_error("io_uring_queue_init failed");
+    throw ::std::runtime_error("eventfd failed");
+  }
+
+  if (cfg_.fixed_files || sqpoll_)
+    register_files();
+
+  send_count_ = std::max<uint32_t>(cfg_.send_slots, 1);
+  send_ = std::make_unique<SendState[]>(send_count_);
+  send_free_.reserve(send_count_);
+  for (uint32_t i = send_count_; i > 0; --i) {
+    send_free_.push_back(i - 1);
+  }
+
+  payload_count_ = std::max<uint32_t>(cfg_.send_payloads, 1);
+  payloads_ = std::make_unique<SharedPayload[]>(payload_count_);
+  zerocopy_ = cfg_.zerocopy_send && register_payloads();
+
+  gso_ = cfg_.gso_send && probe_gso();
+  if (gso_) {
+    gso_max_ = std::clamp<uint32_t>(cfg_.gso_max_segments, 2,
+                                    GsoBatch::kMaxSegments);
+    const uint32_t batches = std::max<uint32_t>(cfg_.gso_slots, 1);
+    gso_batches_ = std::make_unique<GsoBatch[]>(batches);
+    gso_free_.reserve(batches);
+    for (uint32_t i = batches; i > 0; --i) {
+      gso_free_.push_back(i - 1);
+    }
+    groups_.reserve(kSendStage);
   }
 
   for (int i = 0; i < kUdpSlots; ++i) {
     auto &s = udp_[i];
 
-    s.iov.iov_base = s.buf;
-    s.iov.iov_len = UdpState::kBufSize;
-
     std::memset(&s.msg, 0, sizeof(s.msg));
-    s.peer_len = sizeof(s.peer);
-    s.msg.msg_name = &s.peer;
-    s.msg.msg_namelen = s.peer_len;
     s.msg.msg_iov = &s.iov;
     s.msg.msg_iovlen = 1;
   }
 
-  submit_recv(0);
-  submit_recv(1);
+  gro_ = cfg_.gro_recv && probe_gro();
+  init_rx_pool();
+  if (cfg_.multishot_recv && setup_buf_ring()) {
+    multishot_ = true;
+    submit_recv_multishot();
+  } else {
+    for (uint16_t i = 0; i < buf_count_; ++i)
+      rx_free_.push_back(static_cast<uint16_t>(buf_count_ - 1 - i));
+    submit_recv(0);
+    submit_recv(1);
+  }
+  submit_wake_read();
+
+  if (router_cfg.tick_hz > 0) {
+    init_timer(kTickTimer, 1'000'000'000ull / router_cfg.tick_hz);
+  }
+  if (router_.evicting()) {
+    init_timer(kHousekeepingTimer, router_cfg.housekeeping_ms * 1'000'000ull);
+  }
   io_uring_submit(&ring_);
+  router_.start();
+}
+
+void UringDriver::init_ring() {
+  if (cfg_.sqpoll) {
+    io_uring_params p{};
+    p.flags = IORING_SETUP_SQPOLL;
+    p.sq_thread_idle = cfg_.sqpoll_idle_ms;
+    if (cfg_.sqpoll_cpu >= 0) {
+      // One poller per shard, each on its own CPU.
+      const unsigned cpus = std::max(1u, std::thread::hardware_concurrency());
+      p.flags |= IORING_SETUP_SQ_AFF;
+      p.sq_thread_cpu = static_cast<uint32_t>(
+          (size_t(cfg_.sqpoll_cpu) + shard_) % cpus);
+    }
+
+    int rc = io_uring_queue_init_params(kQueueDepth, &ring_, &p);
+    if (rc == 0) {
+      sqpoll_ = true;
+      return;
+    }
+    UDP_WARN("SQPOLL ring unavailable ({}), using a regular ring",
+             strerror(-rc));
+  }
+
+  if (io_uring_queue_init(kQueueDepth, &ring_, 0) < 0) {
+    ::close(fd_);
+    throw ::std::runtime_error("io_uring_queue_init failed");
+  }
+}
+
+void UringDriver::register_files() noexcept {
+  const int fds[] = {fd_, wake_fd_};
+  static_assert(kUdpFileIdx == 0 && kWakeFileIdx == 1);
+
+  int rc = io_uring_register_files(&ring_, fds, 2);
+  if (rc < 0) {
+    UDP_WARN("io_uring_register_files: {}, using plain fds", strerror(-rc));
+    return;
+  }
+  fixed_files_ = true;
+}
+
+void UringDriver::use_udp_file(io_uring_sqe *sqe) const noexcept {
+  if (fixed_files_) {
+    sqe->fd = kUdpFileIdx;
+    sqe->flags |= IOSQE_FIXED_FILE;
+  }
+}
+
+bool UringDriver::register_payloads() noexcept {
+  std::vector<iovec> iovs(payload_count_);
+  for (uint32_t i = 0; i < payload_count_; ++i) {
+    iovs[i].iov_base = payloads_[i].buf.data();
+    iovs[i].iov_len = SharedPayload::kMax;
+  }
+
+  int rc = io_uring_register_buffers(&ring_, iovs.data(), payload_count_);
+  if (rc < 0) {
+    UDP_WARN("io_uring_register_buffers: {}, zero-copy send disabled",
+             strerror(-rc));
+    return false;
+  }
+  return true;
+}
+
+bool UringDriver::probe_gso() const noexcept {
+  int size = 0;
+  socklen_t len = sizeof(size);
+  if (::getsockopt(fd_, SOL_UDP, UDP_SEGMENT, &size, &len) == 0)
+    return true;
+  UDP_WARN("UDP_SEGMENT unavailable ({}), sending datagrams one by one",
+           strerror(errno));
+  return false;
+}
+
+bool UringDriver::probe_gro() const noexcept {
+  int on = 0;
+  socklen_t len = sizeof(on);
+  if (::getsockopt(fd_, SOL_UDP, UDP_GRO, &on, &len) == 0 && on)
+    return true;
+  UDP_WARN("UDP_GRO is not enabled on the socket, receiving datagrams one "
+           "by one");
+  return false;
+}
+
+void UringDriver::init_rx_pool() noexcept {
+  buf_count_ = rx_pool_size(cfg_);
+  // With GRO, multishot buffers also carry the UDP_GRO cmsg.
+  buf_size_ = std::max<uint32_t>(
+      cfg_.recv_buffer_size,
+      sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_storage) +
+          (gro_ ? CMSG_SPACE(sizeof(int)) + kGroMinPayload : 64));
+  buf_pool_ = std::make_unique<std::byte[]>(size_t(buf_count_) * buf_size_);
+  rx_refs_.assign(buf_count_, 0);
+  rx_free_.reserve(buf_count_);
+}
+
+bool UringDriver::setup_buf_ring() noexcept {
+  int err = 0;
+  buf_ring_ =
+      io_uring_setup_buf_ring(&ring_, buf_count_, kRecvBufGroup, 0, &err);
+  if (!buf_ring_) {
+    UDP_WARN("provided buffer ring unavailable ({}), using recv slots",
+             strerror(-err));
+    return false;
+  }
+
+  const int mask = io_uring_buf_ring_mask(buf_count_);
+  for (uint32_t i = 0; i < buf_count_; ++i) {
+    io_uring_buf_ring_add(buf_ring_, rx_buffer(static_cast<uint16_t>(i)),
+                          buf_size_, static_cast<unsigned short>(i), mask,
+                          static_cast<int>(i));
+  }
+  io_uring_buf_ring_advance(buf_ring_, static_cast<int>(buf_count_));
+  ring_bufs_ = buf_count_;
+
+  // Multishot recvmsg only reads the name/control lengths from this header;
+  // the kernel writes the actual peer address into each provided buffer.
+  std::memset(&mshot_msg_, 0, sizeof(mshot_msg_));
+  mshot_msg_.msg_namelen = sizeof(sockaddr_storage);
+  mshot_msg_.msg_controllen = gro_ ? CMSG_SPACE(sizeof(int)) : 0;
+  return true;
+}
+
+void UringDriver::free_buf_ring() noexcept {
+  if (!buf_ring_)
+    return;
+  io_uring_free_buf_ring(&ring_, buf_ring_, buf_count_, kRecvBufGroup);
+  buf_ring_ = nullptr;
+}
+
+void UringDriver::recycle_buffer(uint16_t bid) noexcept {
+  io_uring_buf_ring_add(buf_ring_, rx_buffer(bid), buf_size_, bid,
+                        io_uring_buf_ring_mask(buf_count_), 0);
+  io_uring_buf_ring_advance(buf_ring_, 1);
+  ++ring_bufs_;
+  // Whichever way the buffer came back (router, rate limit, bad datagram,
+  // full router queue), a receive that ran dry can run again.
+  if (recv_starved_)
+    recv_starved_ = !submit_recv_multishot();
+}
+
+void UringDriver::lend_rx(const RxPacket &pkt) noexcept {
+  metrics::count(metrics::Counter::RxPackets);
+  metrics::count(metrics::Counter::RxBytes, pkt.len);
+  ++rx_refs_[pkt.buf];
+  rx_batch_[rx_batched_] = pkt;
+  rx_batch_[rx_batched_++].rx_ns = rx_now_ns_;
+  if (rx_batched_ == kRxBatch)
+    flush_rx();
+}
+
+void UringDriver::lend_datagrams(const sockaddr_storage *peer,
+                                 socklen_t peer_len, const std::byte *data,
+                                 uint32_t len, uint32_t segment,
+                                 uint16_t bid) noexcept {
+  if (segment == 0 || segment >= len) {
+    segment = len;
+  } else {
+    metrics::count(metrics::Counter::RxGroBuffers);
+  }
+
+  // Segments of one GRO read share the buffer; each holds a reference and
+  // counts against the sender's rate limit on its own. They go to the
+  // router in one publish, so it returns the buffer with a single release
+  // (Router::release). The extra reference recycles the buffer here if no
+  // segment is admitted or queued.
+  if (rx_batched_ + (len + segment - 1) / segment > kRxBatch)
+    flush_rx();
+  ++rx_refs_[bid];
+  uint32_t off = 0;
+  do {
+    const uint32_t n = std::min(segment, len - off);
+    if (admit(peer, peer_len)) {
+      RxPacket pkt{};
+      pkt.peer = peer;
+      pkt.peer_len = peer_len;
+      pkt.data = data + off;
+      pkt.len = n;
+      pkt.buf = bid;
+      lend_rx(pkt);
+    }
+    off += n;
+  } while (off < len);
+  release_rx(bid);
+}
+
+void UringDriver::flush_rx() noexcept {
+  if (rx_batched_ == 0)
+    return;
+
+  const size_t queued = router_.enqueue_n(
+      std::span<const RxPacket>(rx_batch_.data(), rx_batched_));
+  if (queued < rx_batched_)
+    metrics::count(metrics::Counter::RouterQueueFull, rx_batched_ - queued);
+  for (size_t i = queued; i < rx_batched_; ++i)
+    release_rx(rx_batch_[i].buf);
+  rx_batched_ = 0;
+}
+
+bool UringDriver::admit(const sockaddr_storage *peer, socklen_t len) noexcept {
+  if (!ingress_limit_.enabled())
+    return true;
+  if (ingress_limit_.allow(Endpoint::from_sockaddr(*peer, len), rx_now_ns_))
+    return true;
+  metrics::count(metrics::Counter::RateLimitedEndpoint);
+  return false;
+}
+
+void UringDriver::release_rx(uint16_t bid, uint16_t refs) noexcept {
+  rx_refs_[bid] -= std::min(rx_refs_[bid], refs);
+  if (rx_refs_[bid] > 0)
+    return;
+
+  if (multishot_) {
+    recycle_buffer(bid);
+    return;
+  }
+
+  rx_free_.push_back(bid);
+  for (uint32_t i = 0; i < kUdpSlots; ++i) {
+    if (!udp_[i].armed)
+      submit_recv(i);
+  }
+}
+
+void UringDriver::reclaim_rx() noexcept {
+  RxRelease rel;
+  while (router_.pop_released(rel)) {
+    release_rx(rel.buf, rel.refs);
+  }
+
+  // Retries a re-arm that found no free SQE.
+  if (recv_starved_ && ring_bufs_ > 0) {
+    recv_starved_ = !submit_recv_multishot();
+  }
+}
+
+void UringDriver::fallback_to_slots() noexcept {
+  UDP_WARN("multishot recvmsg unsupported, falling back to recv slots");
+  multishot_ = false;
+  recv_starved_ = false;
+  free_buf_ring();
+  // Buffers still lent to the router join the free list when returned.
+  for (uint32_t i = buf_count_; i > 0; --i) {
+    if (rx_refs_[i - 1] == 0)
+      rx_free_.push_back(static_cast<uint16_t>(i - 1));
+  }
+  for (uint32_t i = 0; i < kUdpSlots; ++i) {
+    submit_recv(i);
+  }
+}
+
+bool UringDriver::submit_recv_multishot() noexcept {
+  if (io_uring_sqe *sqe = io_uring_get_sqe(&ring_)) {
+    io_uring_prep_recvmsg_multishot(sqe, fd_, &mshot_msg_, 0);
+    use_udp_file(sqe);
+    sqe->flags |= IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kRecvBufGroup;
+    sqe->user_data = pack_ud_slot(Op::RECV_MULTI, 0);
+    return true;
+  }
+  return false;
 }
 
 bool UringDriver::submit_recv(uint32_t slot) noexcept {
   auto &s = udp_[slot];
+  if (s.armed || rx_free_.empty())
+    return false;
 
   if (io_uring_sqe *sqe = io_uring_get_sqe(&ring_)) {
-    s.peer_len = sizeof(s.peer);
-    s.msg.msg_namelen = s.peer_len;
-    s.iov.iov_base = s.buf;
-    s.iov.iov_len = UdpState::kBufSize;
+    s.buf_id = rx_free_.back();
+    rx_free_.pop_back();
+    s.armed = true;
+
+    std::byte *buf = rx_buffer(s.buf_id);
+    s.msg.msg_name = buf;
+    s.msg.msg_namelen = sizeof(sockaddr_storage);
+    s.iov.iov_base = buf + sizeof(sockaddr_storage);
+    s.iov.iov_len = buf_size_ - sizeof(sockaddr_storage);
+    if (gro_) {
+      s.msg.msg_control = s.control.data();
+      s.msg.msg_controllen = s.control.size();
+    }
 
     io_uring_prep_recvmsg(sqe, fd_, &s.msg, 0);
+    use_udp_file(sqe);
     sqe->user_data = pack_ud_slot(Op::RECV, slot);
     return true;
   }
@@ -111,6 +466,7 @@ bool UringDriver::submit_send(uint32_t slot) noexcept {
     s.smsg.msg_iovlen = 1;
 
     io_uring_prep_sendmsg(sqe, fd_, &s.smsg, 0);
+    use_udp_file(sqe);
     sqe->user_data = pack_ud_slot(Op::SEND, slot);
 
     return true;
@@ -127,24 +483,198 @@ bool UringDriver::submit_close(int fd) noexcept {
   return false;
 }
 
-void UringDriver::send_to(const sockaddr_storage &dst, socklen_t dst_len,
-                          const void *data, size_t len) noexcept {
-  if (len > SendState::kMax)
+SharedPayload *UringDriver::acquire_payload(const void *data, size_t len,
+                                            uint32_t &idx_out) noexcept {
+  if (len > SharedPayload::kMax)
+    return nullptr;
+
+  for (uint32_t n = 0; n < payload_count_; n++) {
+    uint32_t i = (payload_rr_ + n) % payload_count_;
+    auto &p = payloads_[i];
+    if (p.refs.load(std::memory_order_acquire) == 0) {
+      payload_rr_ = (i + 1) % payload_count_;
+      p.len = len;
+      std::memcpy(p.buf.data(), data, len);
+      idx_out = i;
+      return &p;
+    }
+  }
+  return nullptr;
+}
+
+void UringDriver::release_payload(uint32_t idx, uint32_t refs) noexcept {
+  payloads_[idx].refs.fetch_sub(refs, std::memory_order_release);
+}
+
+void UringDriver::send_to(const Endpoint &dst, const void *data,
+                          size_t len) noexcept {
+  send_to_all(std::span<const Endpoint>(&dst, 1), data, len);
+}
+
+void UringDriver::send_to_all(std::span<const Endpoint> dsts, const void *data,
+                              size_t len) noexcept {
+  if (dsts.empty())
+    return;
+
+  uint32_t pidx = 0;
+  SharedPayload *p = acquire_payload(data, len, pidx);
+  if (!p) {
+    metrics::count(metrics::Counter::PayloadPoolExhausted, dsts.size());
+    UDP_WARN_EVERY(1000, "send payload pool exhausted: dropping {} send(s)",
+                   dsts.size());
+    return;
+  }
+
+  // Publish every reference up front; the ring thread may complete the
+  // first sends before the last command is queued.
+  const auto total = static_cast<uint32_t>(dsts.size());
+  p->refs.store(total, std::memory_order_relaxed);
+
+  const uint64_t now = metrics::now_ns();
+  uint32_t queued = 0;
+  for (const auto &dst : dsts) {
+    if (!outq_.push(SendCmd{dst, pidx, now}))
+      break;
+    ++queued;
+  }
+
+  if (queued < total) {
+    metrics::count(metrics::Counter::OutboundQueueFull, total - queued);
+    UDP_WARN_EVERY(1000, "outbound queue full: dropping {} send(s)",
+                   total - queued);
+    release_payload(pidx, total - queued);
+  }
+}
+
+void UringDriver::flush() noexcept {
+  // Only the first flush after the ring thread last woke pays for a write;
+  // the ring thread clears the flag before it drains the queue.
+  if (wake_pending_.exchange(true, std::memory_order_acq_rel))
     return;
 
-  uint32_t sidx = 0;
-  SendState *ss = acquire_send_slot(sidx);
-  if (!ss)
+  const uint64_t one = 1;
+  if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    UDP_ERROR_EVERY(1000, "eventfd write: {}", strerror(errno));
+  }
+}
+
+bool UringDriver::submit_wake_read() noexcept {
+  if (io_uring_sqe *sqe = io_uring_get_sqe(&ring_)) {
+    io_uring_prep_read(sqe, wake_fd_, &wake_buf_, sizeof(wake_buf_), 0);
+    if (fixed_files_) {
+      sqe->fd = kWakeFileIdx;
+      sqe->flags |= IOSQE_FIXED_FILE;
+    }
+    sqe->user_data = pack_ud_slot(Op::WAKE, 0);
+    return true;
+  }
+  return false;
+}
+
+void UringDriver::init_timer(uint32_t which, uint64_t period_ns) noexcept {
+  auto &t = timers_[which];
+  t.ts.tv_sec = static_cast<long long>(period_ns / 1'000'000'000ull);
+  t.ts.tv_nsec = static_cast<long long>(period_ns % 1'000'000'000ull);
+  t.enabled = true;
+  t.armed = submit_timer(which);
+}
+
+bool UringDriver::submit_timer(uint32_t which) noexcept {
+  if (io_uring_sqe *sqe = io_uring_get_sqe(&ring_)) {
+    io_uring_prep_timeout(sqe, &timers_[which].ts, 0, 0);
+    sqe->user_data = pack_ud_slot(Op::TIMER, which);
+    return true;
+  }
+  return false;
+}
+
+void UringDriver::on_timer(uint32_t which, int res) noexcept {
+  if (res < 0 && res != -ETIME) {
+    UDP_ERROR_EVERY(1000, "TIMER err={} ({})", strerror(-res), res);
+  }
+  // Keep the marker behind the packets already received this turn.
+  flush_rx();
+  if (which == kTickTimer) {
+    router_.enqueue_tick();
+  } else {
+    router_.enqueue_housekeeping();
+  }
+  timers_[which].armed = submit_timer(which);
+}
+
+void UringDriver::on_wake(int res) noexcept {
+  if (res < 0 && res != -EAGAIN) {
+    UDP_ERROR_EVERY(1000, "WAKE err={} ({})", strerror(-res), res);
+  }
+  wake_pending_.store(false, std::memory_order_release);
+  submit_wake_read();
+}
+
+void UringDriver::drain_outbound() noexcept {
+  if (outq_.empty())
     return;
+  if (gso_) {
+    drain_outbound_gso();
+    return;
+  }
+
+  const uint64_t now = metrics::now_ns();
+  while (!outq_.empty()) {
+    // Leave commands queued while every send slot is in flight; a SEND
+    // completion frees one and the next loop turn picks them up again.
+    uint32_t sidx = 0;
+    SendState *ss = acquire_send_slot(sidx);
+    if (!ss) {
+      metrics::count(metrics::Counter::SendSlotsExhausted);
+      return;
+    }
+
+    if (!outq_.pop(out_cmd_)) {
+      ss->busy = false;
+      send_free_.push_back(sidx);
+      return;
+    }
+
+    if (!submit_cmd(sidx, out_cmd_, now))
+      return;
+  }
+}
 
-  ss->len = len;
-  std::memcpy(ss->buf.data(), data, len);
+bool UringDriver::submit_cmd(uint32_t sidx, const SendCmd &cmd,
+                             uint64_t now) noexcept {
+  SendState *ss = &send_[sidx];
+  io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
+  if (!sqe) {
+    // No SQE available; release slot and payload so they can be reused.
+    ss->busy = false;
+    send_free_.push_back(sidx);
+    release_payload(cmd.payload);
+    metrics::count(metrics::Counter::SqeExhausted);
+    UDP_WARN_EVERY(1000, "submission queue full: dropping send");
+    return false;
+  }
+  metrics::record(metrics::Latency::RouterToSubmit, now - cmd.queued_ns);
+
+  const auto &p = payloads_[cmd.payload];
+  ss->payload = cmd.payload;
+  ss->gso = SendState::kNoGso;
+  ss->iov.iov_base = const_cast<std::byte *>(p.buf.data());
+  ss->iov.iov_len = p.len;
 
-  ss->iov.iov_base = ss->buf.data();
-  ss->iov.iov_len = ss->len;
+  ss->dst_len = cmd.dst.to_sockaddr(ss->dst);
 
-  ss->dst = dst;
-  ss->dst_len = dst_len;
+  ss->zc = zerocopy_ && p.len >= cfg_.zerocopy_threshold;
+  if (ss->zc) {
+    // Payload buffers are registered at the same index as the pool.
+    io_uring_prep_send_zc_fixed(sqe, fd_, p.buf.data(), p.len, 0, 0,
+                                ss->payload);
+    use_udp_file(sqe);
+    io_uring_prep_send_set_addr(sqe,
+                                reinterpret_cast<const sockaddr *>(&ss->dst),
+                                static_cast<uint16_t>(ss->dst_len));
+    sqe->user_data = pack_ud_slot(Op::SEND, sidx);
+    return true;
+  }
 
   std::memset(&ss->msg, 0, sizeof(ss->msg));
   ss->msg.msg_name = &ss->dst;
@@ -152,110 +682,451 @@ void UringDriver::send_to(const sockaddr_storage &dst, socklen_t dst_len,
   ss->msg.msg_iov = &ss->iov;
   ss->msg.msg_iovlen = 1;
 
-  // Queue sendmsg
+  io_uring_prep_sendmsg(sqe, fd_, &ss->msg, 0);
+  use_udp_file(sqe);
+  sqe->user_data = pack_ud_slot(Op::SEND, sidx);
+  return true;
+}
+
+void UringDriver::drain_outbound_gso() noexcept {
+  const uint64_t now = metrics::now_ns();
+  while (!outq_.empty()) {
+    // Each staged command takes at most one send slot and one SQE, so only
+    // as many are taken as both allow; the rest stay queued as above.
+    const size_t room =
+        std::min({send_free_.size(), kSendStage,
+                  size_t(io_uring_sq_space_left(&ring_))});
+    if (room == 0) {
+      metrics::count(send_free_.empty()
+                         ? metrics::Counter::SendSlotsExhausted
+                         : metrics::Counter::SqeExhausted);
+      return;
+    }
+
+    const size_t n = outq_.pop_n(staged_.data(), room);
+    if (n == 0)
+      return;
+
+    group_staged(n);
+    bool ok = true;
+    for (const auto &g : groups_) {
+      if (ok) {
+        ok = submit_group(g.first, now);
+      } else {
+        drop_staged(g.first);
+      }
+      group_index_[g.slot] = 0;
+    }
+    if (!ok)
+      return;
+  }
+}
+
+void UringDriver::group_staged(size_t n) noexcept {
+  constexpr size_t mask = kGroupSlots - 1;
+  static_assert(std::has_single_bit(kGroupSlots));
+
+  groups_.clear();
+  for (size_t i = 0; i < n; ++i) {
+    const auto cmd = static_cast<uint16_t>(i);
+    const auto &dst = staged_[i].dst;
+    staged_next_[i] = kNoCmd;
+
+    size_t h = EndpointHash{}(dst) & mask;
+    for (;; h = (h + 1) & mask) {
+      const uint16_t g = group_index_[h];
+      if (g == 0) {
+        groups_.push_back(DstGroup{cmd, cmd, static_cast<uint16_t>(h)});
+        group_index_[h] = static_cast<uint16_t>(groups_.size());
+        break;
+      }
+      auto &group = groups_[g - 1];
+      if (staged_[group.first].dst == dst) {
+        staged_next_[group.last] = cmd;
+        group.last = cmd;
+        break;
+      }
+    }
+  }
+}
+
+bool UringDriver::submit_group(uint16_t first, uint64_t now) noexcept {
+  uint16_t i = first;
+  while (i != kNoCmd) {
+    // The longest run from i that one GSO send can carry: payloads of the
+    // first one's size, except that a shorter one may end the run.
+    const size_t seg = payloads_[staged_[i].payload].len;
+    uint32_t count = 1;
+    uint16_t end = staged_next_[i];
+    if (gso_ && gso_eligible(seg)) {
+      size_t total = seg;
+      while (end != kNoCmd && count < gso_max_) {
+        const size_t len = payloads_[staged_[end].payload].len;
+        if (len > seg || len == 0 || total + len > kGsoMaxBytes)
+          break;
+        total += len;
+        ++count;
+        end = staged_next_[end];
+        if (len < seg)
+          break;
+      }
+    }
+
+    // drain_outbound_gso() staged no more commands than there are slots.
+    uint32_t sidx = 0;
+    if (!acquire_send_slot(sidx)) {
+      drop_staged(i);
+      return false;
+    }
+    if (count > 1 && !gso_free_.empty()) {
+      if (!submit_gso(sidx, i, count, now)) {
+        drop_staged(i);
+        return false;
+      }
+      i = end;
+      continue;
+    }
+
+    const uint16_t next = staged_next_[i];
+    if (!submit_cmd(sidx, staged_[i], now)) {
+      drop_staged(next);
+      return false;
+    }
+    i = next;
+  }
+  return true;
+}
+
+bool UringDriver::submit_gso(uint32_t sidx, uint16_t first, uint32_t count,
+                             uint64_t now) noexcept {
+  SendState *ss = &send_[sidx];
   io_uring_sqe *sqe = io_uring_get_sqe(&ring_);
   if (!sqe) {
-    // No SQE available; release slot so it can be reused.
     ss->busy = false;
-    return;
+    send_free_.push_back(sidx);
+    return false;
   }
-  io_uring_prep_sendmsg(sqe, fd_, &ss->msg, 0);
 
-  // Tag completion so your CQE handler knows it's a SEND for this slot
+  const uint32_t bidx = gso_free_.back();
+  gso_free_.pop_back();
+  auto &b = gso_batches_[bidx];
+  b.count = count;
+  uint16_t i = first;
+  for (uint32_t k = 0; k < count; ++k, i = staged_next_[i]) {
+    const auto &cmd = staged_[i];
+    auto &p = payloads_[cmd.payload];
+    b.payloads[k] = cmd.payload;
+    b.iov[k].iov_base = p.buf.data();
+    b.iov[k].iov_len = p.len;
+    metrics::record(metrics::Latency::RouterToSubmit, now - cmd.queued_ns);
+  }
+
+  ss->gso = bidx;
+  ss->zc = false;
+  ss->dst_len = staged_[first].dst.to_sockaddr(ss->dst);
+
+  std::memset(&ss->msg, 0, sizeof(ss->msg));
+  ss->msg.msg_name = &ss->dst;
+  ss->msg.msg_namelen = ss->dst_len;
+  ss->msg.msg_iov = b.iov.data();
+  ss->msg.msg_iovlen = count;
+  ss->msg.msg_control = b.control.data();
+  ss->msg.msg_controllen = b.control.size();
+
+  cmsghdr *cm = CMSG_FIRSTHDR(&ss->msg);
+  cm->cmsg_level = SOL_UDP;
+  cm->cmsg_type = UDP_SEGMENT;
+  cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  const auto seg = static_cast<uint16_t>(b.iov[0].iov_len);
+  std::memcpy(CMSG_DATA(cm), &seg, sizeof(seg));
+
+  io_uring_prep_sendmsg(sqe, fd_, &ss->msg, 0);
+  use_udp_file(sqe);
   sqe->user_data = pack_ud_slot(Op::SEND, sidx);
+  metrics::count(metrics::Counter::TxGsoSends);
+  return true;
 }
 
-SendState *UringDriver::acquire_send_slot(uint32_t &idx_out) noexcept {
-  for (uint32_t n = 0; n < kSendSlots; n++) {
-    uint32_t i = (send_rr_ + n) % kSendSlots;
-    if (!send_[i].busy) {
-      send_[i].busy = true;
-      send_rr_ = (i + 1) % kSendSlots;
-      idx_out = i;
-      return &send_[i];
-    }
+void UringDriver::drop_staged(uint16_t first) noexcept {
+  uint32_t dropped = 0;
+  for (uint16_t i = first; i != kNoCmd; i = staged_next_[i]) {
+    release_payload(staged_[i].payload);
+    ++dropped;
   }
-  return nullptr;
+  if (dropped == 0)
+    return;
+  metrics::count(metrics::Counter::SqeExhausted, dropped);
+  UDP_WARN_EVERY(1000, "submission queue full: dropping {} send(s)",
+                 dropped);
 }
 
-void UringDriver::on_send_complete(uint32_t send_idx, int res) noexcept {
-  (void)res;
-  send_[send_idx].busy = false;
+SendState *UringDriver::acquire_send_slot(uint32_t &idx_out) noexcept {
+  if (send_free_.empty())
+    return nullptr;
+  idx_out = send_free_.back();
+  send_free_.pop_back();
+  send_[idx_out].busy = true;
+  return &send_[idx_out];
 }
 
+void UringDriver::on_send_complete(uint32_t send_idx, int res,
+                                   uint32_t flags) noexcept {
+  auto &ss = send_[send_idx];
+  if (!ss.busy)
+    return;
+
+  if (ss.zc && !(flags & IORING_CQE_F_NOTIF)) {
+    if (res == -EINVAL || res == -EOPNOTSUPP) {
+      UDP_WARN("zero-copy send unsupported, falling back to sendmsg");
+      zerocopy_ = false;
+    }
+    // The send result of a zero-copy request. IORING_CQE_F_MORE promises a
+    // second, notification CQE once the kernel has let go of the buffer.
+    if (flags & IORING_CQE_F_MORE)
+      return;
+  }
+
+  ss.busy = false;
+  send_free_.push_back(send_idx);
+  if (ss.gso != SendState::kNoGso) {
+    // EIO: the device cannot checksum-offload, which UDP GSO needs.
+    if (gso_ && (res == -EIO || res == -EOPNOTSUPP || res == -ENOPROTOOPT)) {
+      UDP_WARN("UDP GSO send rejected ({}), sending datagrams one by one",
+               strerror(-res));
+      gso_ = false;
+    }
+    const auto &b = gso_batches_[ss.gso];
+    for (uint32_t k = 0; k < b.count; ++k)
+      release_payload(b.payloads[k]);
+    gso_free_.push_back(ss.gso);
+    ss.gso = SendState::kNoGso;
+    return;
+  }
+  release_payload(ss.payload);
+}
 void UringDriver::recv(uint32_t slot, int res) noexcept {
   auto &s = udp_[slot];
+  s.armed = false;
   if (res < 0) {
-    UDP_LOGLN("RECV(slot=" << slot << ") err=" << strerror(-res) << " ( "
-              << res << ")");
+    metrics::count(metrics::Counter::RecvErrors);
+    UDP_ERROR_EVERY(1000, "RECV(slot={}) err={} ({})", slot, strerror(-res),
+                    res);
+    rx_free_.push_back(s.buf_id);
     submit_recv(slot);
-    io_uring_submit(&ring_);
     return;
   }
 
-  // slot?
-  // res = size
-  // s.buf = actual data
-  std::span<const std::byte> bytes =
-      std::as_bytes(std::span{s.buf, static_cast<size_t>(res)});
-  PacketView pkt{s.peer, s.peer_len, bytes};
-  router_.enqueue_packet(pkt);
+  const std::byte *buf = rx_buffer(s.buf_id);
+  const auto *peer = reinterpret_cast<const sockaddr_storage *>(buf);
+  auto len = static_cast<uint32_t>(res);
+  uint32_t segment = 0;
+  bool keep = true;
+  if (gro_) {
+    for (cmsghdr *cm = CMSG_FIRSTHDR(&s.msg); cm; cm = CMSG_NXTHDR(&s.msg, cm))
+      segment = std::max(segment, gro_segment(cm));
+    // Keep the whole segments of a coalesced read that did not fit.
+    if (segment > 0 && (s.msg.msg_flags & MSG_TRUNC)) {
+      len -= len % segment;
+      keep = len > 0;
+    }
+  }
+  if (keep)
+    lend_datagrams(peer, s.msg.msg_namelen, buf + sizeof(sockaddr_storage),
+                   len, segment, s.buf_id);
+  else
+    rx_free_.push_back(s.buf_id);
 
   submit_recv(slot);
-  io_uring_submit(&ring_);
 }
 
-void UringDriver::send(uint32_t slot, int res) noexcept {
+void UringDriver::recv_multishot(int res, uint32_t flags) noexcept {
+  const bool more = (flags & IORING_CQE_F_MORE) != 0;
+
   if (res < 0) {
-    UDP_LOGLN("SEND error: " << strerror(-res) << " (" << res << ")");
+    if (res == -EINVAL || res == -EOPNOTSUPP) {
+      fallback_to_slots();
+      return;
+    }
+    // -ENOBUFS: the kernel found the ring empty and ended the request.
+    // Re-arm now if buffers were recycled while this completion waited,
+    // otherwise as soon as recycle_buffer() returns one.
+    if (res == -ENOBUFS) {
+      recv_starved_ = ring_bufs_ == 0 || !submit_recv_multishot();
+      return;
+    }
+    metrics::count(metrics::Counter::RecvErrors);
+    UDP_ERROR_EVERY(1000, "RECV_MULTI err={} ({})", strerror(-res), res);
+  } else if (flags & IORING_CQE_F_BUFFER) {
+    const auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+    --ring_bufs_;
+
+    io_uring_recvmsg_out *out =
+        io_uring_recvmsg_validate(rx_buffer(bid), res, &mshot_msg_);
+    const auto *peer =
+        out ? static_cast<const sockaddr_storage *>(io_uring_recvmsg_name(out))
+            : nullptr;
+    const auto peer_len =
+        out ? static_cast<socklen_t>(
+                  std::min<uint32_t>(out->namelen, sizeof(sockaddr_storage)))
+            : 0;
+    uint32_t len = 0;
+    uint32_t segment = 0;
+    bool keep = out != nullptr;
+    if (out) {
+      len = io_uring_recvmsg_payload_length(out, res, &mshot_msg_);
+      for (cmsghdr *cm = io_uring_recvmsg_cmsg_firsthdr(out, &mshot_msg_); cm;
+           cm = io_uring_recvmsg_cmsg_nexthdr(out, &mshot_msg_, cm))
+        segment = std::max(segment, gro_segment(cm));
+      // A truncated datagram is dropped; a truncated GRO read keeps the
+      // segments that fit whole.
+      if (out->flags & MSG_TRUNC) {
+        len = segment > 0 ? len - len % segment : 0;
+        keep = len > 0;
+      }
+    }
+    if (keep)
+      lend_datagrams(peer, peer_len,
+                     static_cast<const std::byte *>(
+                         io_uring_recvmsg_payload(out, &mshot_msg_)),
+                     len, segment, bid);
+    else
+      recycle_buffer(bid);
   }
 
-  if (slot >= kSendSlots) {
-    UDP_LOGLN("SEND completion slot out of range: " << slot);
+  if (!more && multishot_) {
+    submit_recv_multishot();
+  }
+}
+
+void UringDriver::send(uint32_t slot, int res, uint32_t flags) noexcept {
+  if (!(flags & IORING_CQE_F_NOTIF)) {
+    // A GSO send stands for one datagram per segment.
+    const uint32_t datagrams =
+        slot < send_count_ && send_[slot].gso != SendState::kNoGso
+            ? gso_batches_[send_[slot].gso].count
+            : 1;
+    if (res < 0) {
+      metrics::count(metrics::Counter::SendErrors, datagrams);
+      UDP_ERROR_EVERY(1000, "SEND error: {} ({})", strerror(-res), res);
+    } else {
+      metrics::count(metrics::Counter::TxPackets, datagrams);
+      metrics::count(metrics::Counter::TxBytes, static_cast<uint64_t>(res));
+    }
+  }
+
+  if (slot >= send_count_) {
+    UDP_ERROR("SEND completion slot out of range: {}", slot);
     return;
   }
 
-  on_send_complete(slot, res);
+  on_send_complete(slot, res, flags);
+}
 
-  io_uring_submit(&ring_);
+void UringDriver::handle_cqe(const io_uring_cqe *cqe) noexcept {
+  uint64_t ud = cqe->user_data;
+  Op op = unpack_op_slot(ud);
+  uint32_t slot = unpack_slot(ud);
+  int res = cqe->res;
+  uint32_t flags = cqe->flags;
+
+  switch (op) {
+  case Op::RECV:
+    recv(slot, res);
+    break;
+  case Op::RECV_MULTI:
+    recv_multishot(res, flags);
+    break;
+  case Op::SEND:
+    send(slot, res, flags);
+    break;
+  case Op::WAKE:
+    on_wake(res);
+    break;
+  case Op::TIMER:
+    on_timer(slot, res);
+    break;
+  case Op::CLOSE:
+    break;
+  }
+}
+
+void UringDriver::LoopStats::record(uint32_t cqes) noexcept {
+  ++turns;
+  completions += cqes;
+  max_batch = std::max(max_batch, cqes);
+  const auto bucket = cqes == 0 ? 0u : uint32_t(std::bit_width(cqes));
+  ++batch_hist[std::min<size_t>(bucket, batch_hist.size() - 1)];
 }
 
 void UringDriver::start() noexcept {
-  UDP_LOGLN("Server is running on port 9000");
-  std::cerr.flush();
-  while (!g_stop) {
-    io_uring_cqe *cqe{};
-    int rc = io_uring_wait_cqe(&ring_, &cqe);
-    if (rc < 0) {
-      if (rc == -EINTR)
-        continue;
-      UDP_LOGLN("io_uring_wait_cqe: " << strerror(-rc));
-      break;
+  metrics::attach("ring-" + std::to_string(shard_));
+  UDP_INFO("shard {}: ring loop running", shard_);
+  while (!stop_.load(std::memory_order_acquire)) {
+    // Everything queued since the last turn (re-armed receives, drained
+    // sends, the timers) goes to the kernel in the same syscall that
+    // waits for the next completions.
+    reclaim_rx();
+    drain_outbound();
+    for (uint32_t i = 0; i < timers_.size(); ++i) {
+      if (timers_[i].enabled && !timers_[i].armed)
+        timers_[i].armed = submit_timer(i);
     }
 
-    uint64_t ud = cqe->user_data;
-    Op op = unpack_op_slot(ud);
-    uint32_t slot = unpack_slot(ud);
-    int res = cqe->res;
+    // With SQPOLL, io_uring_submit only enters the kernel to wake a sleeping
+    // poller, so skip the wait syscall whenever completions are ready.
+    int rc = (sqpoll_ && io_uring_cq_ready(&ring_) > 0)
+                 ? io_uring_submit(&ring_)
+                 : io_uring_submit_and_wait(&ring_, 1);
+    if (rc < 0 && rc != -EINTR && rc != -EAGAIN && rc != -EBUSY) {
+      UDP_ERROR("io_uring_submit_and_wait: {}", strerror(-rc));
+      break;
+    }
 
-    io_uring_cqe_seen(&ring_, cqe);
+    rx_now_ns_ = metrics::now_ns();
 
-    switch (op) {
-    case Op::RECV:
-      recv(slot, res);
-      break;
-    case Op::SEND:
-      send(slot, res);
-      break;
-    case Op::CLOSE:
-      io_uring_submit(&ring_);
-      break;
+    io_uring_cqe *cqe{};
+    unsigned head = 0;
+    uint32_t seen = 0;
+    io_uring_for_each_cqe(&ring_, head, cqe) {
+      handle_cqe(cqe);
+      ++seen;
     }
+    io_uring_cq_advance(&ring_, seen);
+    loop_stats_.record(seen);
+    // One queue publish and one wakeup check per turn for every packet
+    // received in it.
+    flush_rx();
+    router_.notify();
+  }
+
+  if (loop_stats_.turns > 0) {
+    UDP_INFO("ring loop: {} turns, {} completions, {} per turn (max {})",
+             loop_stats_.turns, loop_stats_.completions,
+             double(loop_stats_.completions) / double(loop_stats_.turns),
+             loop_stats_.max_batch);
+  }
+  if (ingress_limit_.dropped() > 0) {
+    UDP_INFO("rate limited {} packets by source endpoint",
+             ingress_limit_.dropped());
+  }
+}
+
+void UringDriver::stop() noexcept {
+  stop_.store(true, std::memory_order_release);
+  const uint64_t one = 1;
+  if (::write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+    UDP_ERROR_EVERY(1000, "eventfd write: {}", strerror(errno));
   }
 }
 
 UringDriver::~UringDriver() {
+  // The worker may still be sending (queued packets, updates forwarded by
+  // other shards); it must be gone before the eventfd and ring are.
+  router_.stop();
   if (fd_ >= 0)
     ::close(fd_);
+  if (wake_fd_ >= 0)
+    ::close(wake_fd_);
+  free_buf_ring();
   io_uring_queue_exit(&ring_);
 }
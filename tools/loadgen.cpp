@@ -0,0 +1,449 @@
+// Loopback load generator and end-to-end latency benchmark.
+//
+//   udp_loadgen [-a host] [-p port] [-c clients] [-r rate] [-d seconds]
+//               [-f 24|21|h24|h21|mix] [-t threads] [-i first-id]
+//
+// Every simulated client owns a UDP socket, so the server sees a distinct
+// peer per client. It registers with op=0, then sends op=1 updates at
+// `rate` per second in the chosen wire format (h = behind the 8-byte
+// Header; mix rotates through all four). Each update carries its send time
+// in the `size` field (low 32 bits of microseconds on the generator's
+// steady clock), so whatever the server fans out back to the clients gives
+// a one-way latency without any clock sync. Tick-mode batches
+// (core/batch.hpp) are decoded record by record.
+//
+// Loss is measured against immediate-mode fan-out with interest management
+// off: every update to every registered client. Keep `rate` under the
+// server's per-id and per-endpoint rate limits, and remember fan-out is
+// clients^2 * rate datagrams per second.
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "core/batch.hpp"
+#include "core/metrics.hpp"
+#include "core/parser.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using metrics::Histogram;
+
+enum class Format { W24, W21, H24, H21, Mix };
+
+struct Options {
+  std::string host = "127.0.0.1";
+  std::uint16_t port = 9000;
+  std::uint32_t clients = 100;
+  double rate = 10; // updates/s per client
+  double seconds = 10;
+  Format format = Format::W24;
+  std::uint32_t threads = 1;
+  std::uint32_t first_id = 1;
+  // Registrations settle before updates start; in-flight fan-out drains
+  // after they stop.
+  double warmup = 0.5;
+  double drain = 1.0;
+};
+
+struct Stats {
+  std::uint64_t sent = 0;
+  std::uint64_t send_errors = 0;
+  std::uint64_t datagrams = 0;
+  std::uint64_t records = 0;
+  std::uint64_t foreign = 0; // unparseable or not one of our updates
+  std::array<std::uint64_t, Histogram::kBuckets> latency{};
+
+  void merge(const Stats &o) {
+    sent += o.sent;
+    send_errors += o.send_errors;
+    datagrams += o.datagrams;
+    records += o.records;
+    foreign += o.foreign;
+    for (std::size_t b = 0; b < latency.size(); ++b) {
+      latency[b] += o.latency[b];
+    }
+  }
+};
+
+const Clock::time_point g_epoch = Clock::now();
+
+std::uint32_t now_us32() noexcept {
+  return static_cast<std::uint32_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                            g_epoch)
+          .count());
+}
+
+// Little-endian wire encoding of `p` in one of the layouts Parser accepts.
+std::size_t encode(const Players &p, Format f, std::uint32_t seq,
+                   std::byte *out) noexcept {
+  using namespace wire_schema;
+  constexpr auto le = std::endian::little;
+  const bool header = f == Format::H24 || f == Format::H21;
+  const std::size_t wire = (f == Format::W24 || f == Format::H24)
+                               ? Players24::size
+                               : Players21::size;
+  std::byte *w = out;
+  if (header) {
+    PacketHeader::encode<le>(
+        Header{0x55, 1, static_cast<std::uint16_t>(wire), seq}, out);
+    w = out + PacketHeader::size;
+  }
+  if (wire == Players24::size) {
+    Players24::encode<le>(p, w);
+  } else {
+    Players21::encode<le>(p, w);
+  }
+  return (header ? PacketHeader::size : 0) + wire;
+}
+
+struct Client {
+  int fd = -1;
+  std::uint32_t id = 0;
+  std::uint32_t seq = 0;
+  float x = 0;
+  float y = 0;
+};
+
+class Worker {
+public:
+  Worker(const Options &opt, const sockaddr_in &server, std::uint32_t first,
+         std::uint32_t count)
+      : opt_(opt), server_(server), rng_(first) {
+    epfd_ = ::epoll_create1(0);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+    for (std::uint32_t i = 0; i < count; ++i) {
+      Client c;
+      c.id = opt.first_id + first + i;
+      c.x = pos(rng_);
+      c.y = pos(rng_);
+      c.fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+      if (c.fd < 0) {
+        std::perror("socket");
+        break;
+      }
+      const int rcvbuf = 1 << 20;
+      ::setsockopt(c.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+      // Connected: plain send(), and only the server's datagrams arrive.
+      if (::connect(c.fd, reinterpret_cast<const sockaddr *>(&server_),
+                    sizeof(server_)) < 0) {
+        std::perror("connect");
+        ::close(c.fd);
+        break;
+      }
+      epoll_event ev{};
+      ev.events = EPOLLIN;
+      ev.data.u32 = static_cast<std::uint32_t>(clients_.size());
+      ::epoll_ctl(epfd_, EPOLL_CTL_ADD, c.fd, &ev);
+      clients_.push_back(c);
+    }
+  }
+
+  ~Worker() {
+    for (const auto &c : clients_) {
+      ::close(c.fd);
+    }
+    ::close(epfd_);
+  }
+
+  Worker(const Worker &) = delete;
+  Worker &operator=(const Worker &) = delete;
+
+  [[nodiscard]] std::size_t clients() const noexcept {
+    return clients_.size();
+  }
+  [[nodiscard]] const Stats &stats() const noexcept { return stats_; }
+
+  void run(Clock::time_point start, Clock::time_point stop,
+           Clock::time_point done) {
+    for (auto &c : clients_) {
+      send(c, 0);
+    }
+    poll_until(start);
+
+    if (!clients_.empty() && opt_.rate > 0) {
+      // Updates are spread evenly over the thread's clients.
+      const auto interval = std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(1.0 / (opt_.rate * clients_.size())));
+      auto next = start;
+      std::size_t rr = 0;
+      for (auto now = Clock::now(); now < stop; now = Clock::now()) {
+        while (next <= now && next < stop) {
+          send(clients_[rr], 1);
+          rr = rr + 1 == clients_.size() ? 0 : rr + 1;
+          next += interval;
+        }
+        poll_once(std::min(next, stop) - Clock::now());
+      }
+    }
+    poll_until(done);
+  }
+
+private:
+  void send(Client &c, std::uint32_t op) {
+    std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+    c.x = std::clamp(c.x + step(rng_), -1000.0f, 1000.0f);
+    c.y = std::clamp(c.y + step(rng_), -1000.0f, 1000.0f);
+    const Players p{op, c.id, c.x, c.y, static_cast<std::uint8_t>(c.seq),
+                    now_us32()};
+    const Format f =
+        opt_.format == Format::Mix ? static_cast<Format>(c.seq % 4)
+                                   : opt_.format;
+    std::array<std::byte, 64> buf;
+    const auto len = encode(p, f, c.seq++, buf.data());
+    if (::send(c.fd, buf.data(), len, 0) < 0) {
+      ++stats_.send_errors;
+    } else if (op == 1) {
+      ++stats_.sent;
+    }
+  }
+
+  void poll_until(Clock::time_point until) {
+    for (auto now = Clock::now(); now < until; now = Clock::now()) {
+      poll_once(until - now);
+    }
+  }
+
+  void poll_once(Clock::duration wait) {
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(wait);
+    std::array<epoll_event, 64> events;
+    const int n = ::epoll_wait(epfd_, events.data(),
+                               static_cast<int>(events.size()),
+                               static_cast<int>(std::max<long>(0, ms.count())));
+    for (int i = 0; i < n; ++i) {
+      drain(clients_[events[i].data.u32]);
+    }
+  }
+
+  void drain(const Client &c) {
+    std::array<std::byte, 2048> buf;
+    for (;;) {
+      const auto n = ::recv(c.fd, buf.data(), buf.size(), 0);
+      if (n < 0) {
+        return; // EAGAIN, or ECONNREFUSED while the server is down
+      }
+      const std::uint32_t now = now_us32();
+      const std::span<const std::byte> bytes(buf.data(),
+                                             static_cast<std::size_t>(n));
+      ++stats_.datagrams;
+      if (const auto h = BatchReader::header(bytes)) {
+        for (std::size_t r = 0; r < h->count; ++r) {
+          record(BatchReader::record(bytes, r), now);
+        }
+      } else if (const auto p = parser_.parse(bytes)) {
+        record(*p, now);
+      } else {
+        ++stats_.foreign;
+      }
+    }
+  }
+
+  void record(const Players &p, std::uint32_t now) {
+    if (p.op != 1 || p.id < opt_.first_id ||
+        p.id - opt_.first_id >= opt_.clients) {
+      ++stats_.foreign;
+      return;
+    }
+    ++stats_.records;
+    // Unsigned wrap-around keeps this right across the 71-minute rollover.
+    const std::uint64_t us = now - p.size;
+    ++stats_.latency[Histogram::bucket_of(us * 1000)];
+  }
+
+  const Options &opt_;
+  sockaddr_in server_;
+  std::mt19937 rng_;
+  Parser parser_;
+  int epfd_ = -1;
+  std::vector<Client> clients_;
+  Stats stats_;
+};
+
+// Upper edge of the bucket holding quantile q, in microseconds.
+double quantile_us(const Stats &s, std::uint64_t total, double q) {
+  const auto rank = static_cast<std::uint64_t>(q * double(total - 1)) + 1;
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < s.latency.size(); ++b) {
+    seen += s.latency[b];
+    if (seen >= rank) {
+      const auto ns = b + 1 < s.latency.size()
+                          ? Histogram::bucket_floor(b + 1) - 1
+                          : Histogram::bucket_floor(b);
+      return double(ns) / 1e3;
+    }
+  }
+  return 0;
+}
+
+bool parse_format(const std::string &s, Format &f) {
+  static const std::pair<const char *, Format> kNames[] = {
+      {"24", Format::W24},  {"21", Format::W21},  {"h24", Format::H24},
+      {"h21", Format::H21}, {"mix", Format::Mix},
+  };
+  for (const auto &[name, value] : kNames) {
+    if (s == name) {
+      f = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "usage: %s [-a host] [-p port] [-c clients] [-r rate] "
+               "[-d seconds] [-f 24|21|h24|h21|mix] [-t threads] "
+               "[-i first-id]\n",
+               argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  std::string format = "24";
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc || arg.size() != 2 || arg[0] != '-') {
+      usage(argv[0]);
+      return 2;
+    }
+    const char *val = argv[++i];
+    switch (arg[1]) {
+    case 'a':
+      opt.host = val;
+      break;
+    case 'p':
+      opt.port = static_cast<std::uint16_t>(std::atoi(val));
+      break;
+    case 'c':
+      opt.clients = static_cast<std::uint32_t>(std::atol(val));
+      break;
+    case 'r':
+      opt.rate = std::atof(val);
+      break;
+    case 'd':
+      opt.seconds = std::atof(val);
+      break;
+    case 'f':
+      format = val;
+      break;
+    case 't':
+      opt.threads = static_cast<std::uint32_t>(std::atol(val));
+      break;
+    case 'i':
+      opt.first_id = static_cast<std::uint32_t>(std::atol(val));
+      break;
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (!parse_format(format, opt.format) || opt.clients == 0) {
+    usage(argv[0]);
+    return 2;
+  }
+  opt.threads = std::clamp<std::uint32_t>(opt.threads, 1, opt.clients);
+
+  sockaddr_in server{};
+  server.sin_family = AF_INET;
+  server.sin_port = htons(opt.port);
+  if (::inet_pton(AF_INET, opt.host.c_str(), &server.sin_addr) != 1) {
+    std::fprintf(stderr, "bad IPv4 address: %s\n", opt.host.c_str());
+    return 2;
+  }
+
+  // One socket per client.
+  rlimit lim{};
+  if (::getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+    lim.rlim_cur = lim.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &lim);
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::uint32_t clients = 0;
+  for (std::uint32_t t = 0; t < opt.threads; ++t) {
+    const std::uint32_t first = opt.clients * t / opt.threads;
+    const std::uint32_t last = opt.clients * (t + 1) / opt.threads;
+    workers.push_back(
+        std::make_unique<Worker>(opt, server, first, last - first));
+    clients += static_cast<std::uint32_t>(workers.back()->clients());
+  }
+  if (clients < opt.clients) {
+    std::fprintf(stderr, "only %u of %u client sockets opened\n", clients,
+                 opt.clients);
+    return 1;
+  }
+
+  const auto sec = [](double s) {
+    return std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(s));
+  };
+  const auto start = Clock::now() + sec(opt.warmup);
+  const auto stop = start + sec(opt.seconds);
+  const auto done = stop + sec(opt.drain);
+
+  std::vector<std::thread> threads;
+  for (auto &w : workers) {
+    threads.emplace_back([&w, start, stop, done] { w->run(start, stop, done); });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  Stats total;
+  for (const auto &w : workers) {
+    total.merge(w->stats());
+  }
+
+  const std::uint64_t expected = total.sent * clients;
+  std::printf("%u clients, %.1f updates/s each, %.1f s, format %s, %u "
+              "thread(s)\n",
+              clients, opt.rate, opt.seconds, format.c_str(), opt.threads);
+  std::printf("sent       %llu updates (%.0f/s), %llu send errors\n",
+              static_cast<unsigned long long>(total.sent),
+              double(total.sent) / opt.seconds,
+              static_cast<unsigned long long>(total.send_errors));
+  std::printf("delivered  %llu updates in %llu datagrams (%.0f/s), %llu "
+              "foreign\n",
+              static_cast<unsigned long long>(total.records),
+              static_cast<unsigned long long>(total.datagrams),
+              double(total.records) / opt.seconds,
+              static_cast<unsigned long long>(total.foreign));
+  if (expected > 0) {
+    std::printf("expected   %llu (loss %.3f%%)\n",
+                static_cast<unsigned long long>(expected),
+                100.0 * (1.0 - double(std::min(total.records, expected)) /
+                                   double(expected)));
+  }
+  if (total.records > 0) {
+    std::printf("latency us p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  "
+                "max %.1f\n",
+                quantile_us(total, total.records, 0.5),
+                quantile_us(total, total.records, 0.9),
+                quantile_us(total, total.records, 0.99),
+                quantile_us(total, total.records, 0.999),
+                quantile_us(total, total.records, 1.0));
+  }
+  return 0;
+}
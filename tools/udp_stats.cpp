@@ -0,0 +1,244 @@
+// Reads the server's shared-memory metrics segment (core/metrics.hpp).
+//
+//   udp_stats [-s /shm-name] [-t] [-i seconds]
+//
+// Prints counters summed over every thread slot and percentiles of each
+// latency histogram. -t adds a per-thread counter breakdown; -i repeats
+// every `seconds` and prints per-second rates alongside the totals.
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/metrics.hpp"
+
+namespace {
+
+constexpr std::size_t kCounters =
+    static_cast<std::size_t>(metrics::Counter::Count);
+constexpr std::size_t kLatencies =
+    static_cast<std::size_t>(metrics::Latency::Count);
+
+struct Totals {
+  std::array<std::uint64_t, kCounters> counters{};
+  std::array<std::array<std::uint64_t, metrics::Histogram::kBuckets>,
+             kLatencies>
+      latency{};
+};
+
+const metrics::Segment *map_segment(const char *name) {
+  const int fd = ::shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    std::fprintf(stderr, "shm_open(%s): %s\n", name, std::strerror(errno));
+    return nullptr;
+  }
+  struct stat st{};
+  if (::fstat(fd, &st) < 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(metrics::Segment)) {
+    std::fprintf(stderr, "%s: segment too small (server not started?)\n",
+                 name);
+    ::close(fd);
+    return nullptr;
+  }
+  void *mem =
+      ::mmap(nullptr, sizeof(metrics::Segment), PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED) {
+    std::perror("mmap");
+    return nullptr;
+  }
+
+  const auto *seg = static_cast<const metrics::Segment *>(mem);
+  if (seg->magic != metrics::kMagic || seg->version != metrics::kVersion ||
+      seg->slot_size != sizeof(metrics::Slot)) {
+    std::fprintf(stderr, "%s: not a compatible stats segment\n", name);
+    return nullptr;
+  }
+  return seg;
+}
+
+// The owner's pid, zeroed while a new server resets the segment in
+// place (metrics::open), so a change marks a restart.
+std::int64_t owner_pid(const metrics::Segment &seg) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return std::atomic_ref<std::int64_t>(const_cast<std::int64_t &>(seg.pid))
+      .load(std::memory_order_acquire);
+}
+
+// True if `now` cannot follow `prev` in one run: the server was
+// restarted and the counters started over.
+bool restarted(const Totals &prev, const Totals &now) {
+  for (std::size_t c = 0; c < kCounters; ++c) {
+    if (now.counters[c] < prev.counters[c]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Totals sum(const metrics::Segment &seg) {
+  Totals t;
+  for (const auto &slot : seg.slot) {
+    if (slot.in_use.load(std::memory_order_acquire) == 0) {
+      continue;
+    }
+    for (std::size_t c = 0; c < kCounters; ++c) {
+      t.counters[c] += slot.counters[c].load(std::memory_order_relaxed);
+    }
+    for (std::size_t h = 0; h < kLatencies; ++h) {
+      for (std::size_t b = 0; b < metrics::Histogram::kBuckets; ++b) {
+        t.latency[h][b] +=
+            slot.latency[h].counts[b].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  return t;
+}
+
+// Upper edge of the bucket holding the q-th quantile (HDR convention: the
+// reported value is never below the true one by more than a bucket).
+std::uint64_t quantile(
+    const std::array<std::uint64_t, metrics::Histogram::kBuckets> &h,
+    std::uint64_t total, double q) {
+  const auto rank = static_cast<std::uint64_t>(q * double(total - 1)) + 1;
+  std::uint64_t seen = 0;
+  for (std::size_t b = 0; b < h.size(); ++b) {
+    seen += h[b];
+    if (seen >= rank) {
+      return b + 1 < h.size() ? metrics::Histogram::bucket_floor(b + 1) - 1
+                              : metrics::Histogram::bucket_floor(b);
+    }
+  }
+  return 0;
+}
+
+void print_latency(const Totals &t) {
+  std::printf("\n%-18s %10s %9s %9s %9s %9s %9s\n", "latency (us)", "samples",
+              "p50", "p90", "p99", "p99.9", "max");
+  for (std::size_t h = 0; h < kLatencies; ++h) {
+    std::uint64_t total = 0;
+    for (auto n : t.latency[h]) {
+      total += n;
+    }
+    std::printf("%-18.*s %10llu",
+                static_cast<int>(metrics::kLatencyNames[h].size()),
+                metrics::kLatencyNames[h].data(),
+                static_cast<unsigned long long>(total));
+    if (total == 0) {
+      std::printf("\n");
+      continue;
+    }
+    for (double q : {0.5, 0.9, 0.99, 0.999, 1.0}) {
+      std::printf(" %9.1f", double(quantile(t.latency[h], total, q)) / 1e3);
+    }
+    std::printf("\n");
+  }
+}
+
+void print_threads(const metrics::Segment &seg) {
+  std::printf("\n%-16s", "thread");
+  for (std::size_t c = 0; c < kCounters; ++c) {
+    std::printf(" %.*s", static_cast<int>(metrics::kCounterNames[c].size()),
+                metrics::kCounterNames[c].data());
+  }
+  std::printf("\n");
+  for (const auto &slot : seg.slot) {
+    if (slot.in_use.load(std::memory_order_acquire) == 0) {
+      continue;
+    }
+    std::printf("%-16.*s", static_cast<int>(metrics::kNameLen), slot.name);
+    for (std::size_t c = 0; c < kCounters; ++c) {
+      std::printf(" %*llu", static_cast<int>(metrics::kCounterNames[c].size()),
+                  static_cast<unsigned long long>(
+                      slot.counters[c].load(std::memory_order_relaxed)));
+    }
+    std::printf("\n");
+  }
+}
+
+void usage(const char *argv0) {
+  std::fprintf(stderr, "usage: %s [-s /shm-name] [-t] [-i seconds]\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::string name = metrics::kDefaultShmName;
+  bool threads = false;
+  double interval = 0;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "-s" && i + 1 < argc) {
+      name = argv[++i];
+    } else if (arg == "-t") {
+      threads = true;
+    } else if (arg == "-i" && i + 1 < argc) {
+      interval = std::atof(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  const metrics::Segment *seg = map_segment(name.c_str());
+  if (!seg) {
+    return 1;
+  }
+
+  Totals prev = sum(*seg);
+  std::int64_t prev_pid = owner_pid(*seg);
+  for (;;) {
+    if (interval > 0) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+    }
+    const Totals now = sum(*seg);
+    // Read after summing: a reset that began during the sum has already
+    // zeroed the pid.
+    const std::int64_t pid = owner_pid(*seg);
+    // Deltas across a restart are meaningless; start over from `now`.
+    const bool rates =
+        interval > 0 && pid != 0 && pid == prev_pid && !restarted(prev, now);
+
+    std::printf("pid %lld, %s%s\n", static_cast<long long>(pid), name.c_str(),
+                interval > 0 && !rates ? " (restarted, rates reset)" : "");
+    std::printf("%-24s %16s%s\n", "counter", "total",
+                interval > 0 ? "            /s" : "");
+    for (std::size_t c = 0; c < kCounters; ++c) {
+      std::printf("%-24.*s %16llu",
+                  static_cast<int>(metrics::kCounterNames[c].size()),
+                  metrics::kCounterNames[c].data(),
+                  static_cast<unsigned long long>(now.counters[c]));
+      if (rates) {
+        std::printf(" %13.0f",
+                    double(now.counters[c] - prev.counters[c]) / interval);
+      } else if (interval > 0) {
+        std::printf(" %13s", "-");
+      }
+      std::printf("\n");
+    }
+    print_latency(now);
+    if (threads) {
+      print_threads(*seg);
+    }
+
+    if (interval <= 0) {
+      break;
+    }
+    prev = now;
+    prev_pid = pid;
+    std::printf("\n");
+  }
+  return 0;
+}